@@ -0,0 +1,150 @@
+#include "AllocTracker.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <new>
+
+using namespace std;
+
+const char *const AllocTracker::Site_Names[AllocTracker::Site_Count] = {
+        "(unattributed)", "Position(fen)", "copy", "get_pseudolegal_moves", "get_all_pseudolegal_moves",
+        "get_all_pseudolegal_capture_moves", "get_all_legal_moves", "sort_moves", "perft", "perft_parallel",
+        "minimax", "search_captures"
+};
+
+// The registry must not allocate through operator new itself: blocks come from calloc and live in a fixed table.
+static const int Max_Threads = 256;
+static AllocTracker::Counters *registry[Max_Threads];
+static atomic<int> registered(0);
+static AllocTracker::Counters overflow; // shared (racy) block for threads beyond Max_Threads
+
+static thread_local AllocTracker::Counters *local_counters = nullptr;
+static thread_local int local_site = AllocTracker::Unattributed;
+
+static string region_name;
+static bool has_report = false;
+static AllocTracker::Counters report;
+
+AllocTracker::Counters &AllocTracker::thread_counters() {
+    if (local_counters == nullptr) {
+        int slot = registered.fetch_add(1);
+        if (slot < Max_Threads) {
+            local_counters = (Counters *) calloc(1, sizeof(Counters));
+            registry[slot] = local_counters;
+        } else {
+            local_counters = &overflow;
+        }
+    }
+    return *local_counters;
+}
+
+int &AllocTracker::current_site() {
+    return local_site;
+}
+
+void AllocTracker::begin_region(const string &name) {
+    int count = min(registered.load(), Max_Threads);
+    for (int i = 0; i < count; ++i) if (registry[i] != nullptr) memset(registry[i], 0, sizeof(Counters));
+    memset(&overflow, 0, sizeof(overflow));
+    region_name = name;
+}
+
+void AllocTracker::end_region() {
+    memset(&report, 0, sizeof(report));
+    int count = min(registered.load(), Max_Threads);
+    for (int t = 0; t <= count; ++t) {
+        Counters *counters = (t < count) ? registry[t] : &overflow;
+        if (counters == nullptr) continue;
+        for (int i = 0; i < Site_Count; ++i) {
+            report.calls[i] += counters->calls[i];
+            report.allocations[i] += counters->allocations[i];
+            report.bytes[i] += counters->bytes[i];
+        }
+        report.frees += counters->frees;
+    }
+    has_report = true;
+}
+
+void AllocTracker::print_report() {
+#ifndef CHESS_ALLOC_TRACK
+    cout << "allocation tracking is disabled in this build (configure with -DCHESS_ALLOC_TRACK=ON)" << endl;
+#else
+    if (!has_report) {
+        cout << "nothing tracked yet, run perft, divide, calculate or bench first" << endl;
+        return;
+    }
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0;
+    for (int i = 0; i < Site_Count; ++i) {
+        allocations += report.allocations[i];
+        bytes += report.bytes[i];
+    }
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << "allocations of '" << region_name << "': " << allocations << " allocations, " << bytes << " bytes, " <<
+         report.frees << " frees" << endl;
+    cout << left << setw(36) << "site" << right << setw(14) << "calls" << setw(14) << "allocations" <<
+         setw(16) << "bytes" << setw(12) << "allocs/call" << setw(12) << "bytes/call" << endl;
+    cout << fixed << setprecision(2);
+    for (int i = 0; i < Site_Count; ++i) {
+        if (report.calls[i] == 0 && report.allocations[i] == 0) continue;
+        cout << left << setw(36) << Site_Names[i] << right << setw(14) << report.calls[i] << setw(14) <<
+             report.allocations[i] << setw(16) << report.bytes[i];
+        if (report.calls[i] != 0) {
+            cout << setw(12) << (double) report.allocations[i] / report.calls[i] <<
+                 setw(12) << (double) report.bytes[i] / report.calls[i];
+        }
+        cout << endl;
+    }
+    // everything allocated below a node (move generation, sorting, copies) is charged to that node here
+    unsigned long long perft_nodes = report.calls[Perft];
+    unsigned long long search_nodes = report.calls[Minimax] + report.calls[Search_Captures];
+    if (perft_nodes != 0 && search_nodes == 0) {
+        cout << "per perft node: " << (double) allocations / perft_nodes << " allocations, " <<
+             (double) bytes / perft_nodes << " bytes" << endl;
+    } else if (search_nodes != 0 && perft_nodes == 0) {
+        cout << "per search node: " << (double) allocations / search_nodes << " allocations, " <<
+             (double) bytes / search_nodes << " bytes" << endl;
+    } else if (perft_nodes != 0) {
+        cout << "per node (perft + search): " << (double) allocations / (perft_nodes + search_nodes) <<
+             " allocations, " << (double) bytes / (perft_nodes + search_nodes) << " bytes" << endl;
+    }
+    cout.flags(flags);
+    cout.precision(precision);
+#endif
+}
+
+#ifdef CHESS_ALLOC_TRACK
+
+static void *tracked_allocate(size_t size, bool nothrow) {
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        if (nothrow) return nullptr;
+        throw bad_alloc();
+    }
+    AllocTracker::Counters &counters = AllocTracker::thread_counters();
+    counters.allocations[local_site]++;
+    counters.bytes[local_site] += size;
+    return ptr;
+}
+
+static void tracked_free(void *ptr) {
+    if (ptr == nullptr) return;
+    AllocTracker::thread_counters().frees++;
+    free(ptr);
+}
+
+void *operator new(size_t size) { return tracked_allocate(size, false); }
+void *operator new[](size_t size) { return tracked_allocate(size, false); }
+void *operator new(size_t size, const nothrow_t &) noexcept { return tracked_allocate(size, true); }
+void *operator new[](size_t size, const nothrow_t &) noexcept { return tracked_allocate(size, true); }
+void operator delete(void *ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, const nothrow_t &) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, const nothrow_t &) noexcept { tracked_free(ptr); }
+
+#endif
@@ -0,0 +1,65 @@
+#include <string>
+
+#ifndef CHESS_ALLOCTRACKER_H
+#define CHESS_ALLOCTRACKER_H
+
+using namespace std;
+
+// Allocation tracking. Configure with -DCHESS_ALLOC_TRACK=ON to replace the global operator new/delete with
+// counting versions; every allocation is charged to the innermost ALLOC_SITE on the allocating thread.
+// In a normal build the ALLOC_* macros expand to nothing and the standard allocator is untouched.
+class AllocTracker {
+public:
+    static const int Unattributed = 0;
+    static const int Fen_Parsing = 1;
+    static const int Position_Copy = 2;
+    static const int Pseudolegal_Moves = 3; // get_pseudolegal_moves (one square)
+    static const int All_Pseudolegal_Moves = 4;
+    static const int Capture_Moves = 5;
+    static const int Legal_Moves = 6;
+    static const int Sort_Moves = 7;
+    static const int Perft = 8;
+    static const int Perft_Parallel = 9;
+    static const int Minimax = 10;
+    static const int Search_Captures = 11;
+    static const int Site_Count = 12;
+    static const char *const Site_Names[Site_Count];
+
+    struct Counters {
+        unsigned long long calls[Site_Count]; // how often the site was entered
+        unsigned long long allocations[Site_Count];
+        unsigned long long bytes[Site_Count];
+        unsigned long long frees;
+    };
+
+    static Counters &thread_counters();
+    static int &current_site(); // innermost site of the calling thread
+    static void begin_region(const string &name);
+    static void end_region();
+    static void print_report();
+};
+
+class Alloc_Site {
+public:
+    explicit Alloc_Site(int site) : previous(AllocTracker::current_site()) {
+        AllocTracker::current_site() = site;
+        AllocTracker::thread_counters().calls[site]++;
+    };
+    ~Alloc_Site() { AllocTracker::current_site() = previous; }
+private:
+    int previous;
+};
+
+#ifdef CHESS_ALLOC_TRACK
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+#define ALLOC_SITE(site) Alloc_Site ALLOC_CONCAT(alloc_site_, __LINE__)(site)
+#define ALLOC_BEGIN(name) AllocTracker::begin_region(name)
+#define ALLOC_END() AllocTracker::end_region()
+#else
+#define ALLOC_SITE(site)
+#define ALLOC_BEGIN(name)
+#define ALLOC_END()
+#endif
+
+#endif //CHESS_ALLOCTRACKER_H
@@ -0,0 +1,433 @@
+#include "Bench.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+#include "SplitPerft.h"
+#include "EvalCache.h"
+#include "PackedPosition.h"
+#include "Pgn.h"
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <omp.h>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+
+using namespace std;
+
+const vector<string> Bench::Positions = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point begin) {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return (double) std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000;
+}
+
+void Bench::run(int perft_depth, int search_depth) {
+    long long int total_perft_nodes = 0;
+    long long int total_search_nodes = 0;
+    double total_perft_time = 0.0;
+    long long int total_bulk_nodes = 0;
+    double total_bulk_time = 0.0;
+    double total_search_time = 0.0;
+    PROFILE_BEGIN("bench");
+    ALLOC_BEGIN("bench");
+    EvalCache::reset_statistics();
+    for (const string &fen : Positions) {
+        Position pos = Position(fen);
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        long long int perft_nodes = pos.perft_parallel(perft_depth);
+        double perft_time = seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        long long int bulk_nodes = pos.perft_bulk_parallel(perft_depth);
+        double bulk_time = seconds_since(begin);
+        begin = std::chrono::steady_clock::now();
+        pos.minimax(search_depth, search_depth, -30000, 30000);
+        double search_time = seconds_since(begin);
+        cout << fen << endl;
+        cout << "\t perft " << perft_depth << ": " << perft_nodes << " nodes in " << perft_time << " seconds" << endl;
+        cout << "\t bulk perft " << perft_depth << ": " << bulk_nodes << " nodes in " << bulk_time << " seconds" << endl;
+        cout << "\t search " << search_depth << ": " << pos.nodes << " nodes in " << search_time << " seconds"
+             << " (best move " << pos.best_move.to_letter_string() << ")" << endl;
+        total_perft_nodes += perft_nodes;
+        total_perft_time += perft_time;
+        total_bulk_nodes += bulk_nodes;
+        total_bulk_time += bulk_time;
+        total_search_nodes += pos.nodes;
+        total_search_time += search_time;
+    }
+    ALLOC_END();
+    PROFILE_END();
+    cout << endl;
+    cout << "perft:  " << total_perft_nodes << " nodes in " << total_perft_time << " seconds (" <<
+         (long long int) (total_perft_nodes / total_perft_time) << " nps)" << endl;
+    cout << "bulk:   " << total_bulk_nodes << " nodes in " << total_bulk_time << " seconds (" <<
+         (long long int) (total_bulk_nodes / total_bulk_time) << " nps)" << endl;
+    cout << "search: " << total_search_nodes << " nodes in " << total_search_time << " seconds (" <<
+         (long long int) (total_search_nodes / total_search_time) << " nps)" << endl;
+    cout << "        " << EvalCache::statistics() << endl;
+}
+
+bool Bench::scaling(int max_threads, int perft_depth, int search_depth, const string &csv_file) {
+    ofstream csv(csv_file);
+    if (!csv) return false;
+    csv << "workload,depth,threads,nodes,seconds,nps,speedup,efficiency,node_overhead" << endl;
+    vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+    int previous_max_threads = omp_get_max_threads();
+    double perft_base_time = 0.0;
+    double split_base_time = 0.0;
+    double search_base_time = 0.0;
+    long long int search_base_nodes = 0;
+    cout << left << setw(8) << "threads" << right << setw(14) << "bulk nps" << setw(10) << "speedup" <<
+         setw(12) << "efficiency" << setw(14) << "split nps" << setw(10) << "speedup" << setw(12) << "efficiency" <<
+         setw(14) << "search nps" << setw(10) << "speedup" << setw(12) << "efficiency" <<
+         setw(16) << "node overhead" << endl;
+    for (int threads : thread_counts) {
+        omp_set_num_threads(threads);
+        long long int perft_nodes = 0;
+        double perft_time = 0.0;
+        long long int split_nodes = 0;
+        double split_time = 0.0;
+        long long int search_nodes = 0;
+        double search_time = 0.0;
+        vector<long long int> root_counts;
+        for (const string &fen : Positions) {
+            Position pos = Position(fen);
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            // bulk counted like the SplitPerft leaves, so the two compare the same tree and leaf counting
+            perft_nodes += pos.perft_bulk_parallel(perft_depth);
+            perft_time += seconds_since(begin);
+            begin = std::chrono::steady_clock::now();
+            split_nodes += SplitPerft::run(pos, perft_depth, SplitPerft::Default_Split_Depth, root_counts);
+            split_time += seconds_since(begin);
+            begin = std::chrono::steady_clock::now();
+            pos.minimax_parallel(search_depth, -30000, 30000);
+            search_time += seconds_since(begin); // time to depth
+            search_nodes += pos.nodes;
+        }
+        if (threads == 1) {
+            perft_base_time = perft_time;
+            split_base_time = split_time;
+            search_base_time = search_time;
+            search_base_nodes = search_nodes;
+        }
+        double perft_speedup = perft_base_time / perft_time;
+        double split_speedup = split_base_time / split_time;
+        double search_speedup = search_base_time / search_time;
+        double node_overhead = (double) search_nodes / search_base_nodes;
+        csv << "bulk perft," << perft_depth << "," << threads << "," << perft_nodes << "," << perft_time << "," <<
+            (long long int) (perft_nodes / perft_time) << "," << perft_speedup << "," << perft_speedup / threads <<
+            ",1" << endl;
+        csv << "split perft," << perft_depth << "," << threads << "," << split_nodes << "," << split_time << "," <<
+            (long long int) (split_nodes / split_time) << "," << split_speedup << "," << split_speedup / threads <<
+            ",1" << endl;
+        csv << "search," << search_depth << "," << threads << "," << search_nodes << "," << search_time << "," <<
+            (long long int) (search_nodes / search_time) << "," << search_speedup << "," <<
+            search_speedup / threads << "," << node_overhead << endl;
+        cout << left << setw(8) << threads << right << setw(14) << (long long int) (perft_nodes / perft_time) <<
+             setw(10) << perft_speedup << setw(12) << perft_speedup / threads <<
+             setw(14) << (long long int) (split_nodes / split_time) << setw(10) << split_speedup <<
+             setw(12) << split_speedup / threads <<
+             setw(14) << (long long int) (search_nodes / search_time) << setw(10) << search_speedup <<
+             setw(12) << search_speedup / threads << setw(16) << node_overhead << endl;
+    }
+    omp_set_num_threads(previous_max_threads);
+    return true;
+}
+
+static const int Max_Game_Plies = 120;
+
+// 1 if the network wins, 0 for a draw, -1 if it loses. Games that reach Max_Game_Plies are decided by the classical
+// evaluation with a one pawn margin.
+static int play_game(const string &fen, bool network_white, double seconds_per_move) {
+    Position pos = Position(fen);
+    for (int ply = 0; ply < Max_Game_Plies; ++ply) {
+        if (pos.get_all_legal_moves().empty()) {
+            if (!pos.is_threatened(pos.enemy_king_index)) return 0;
+            return pos.white_move == network_white ? -1 : 1;
+        }
+        Nnue::Enabled = pos.white_move == network_white;
+        if (Nnue::Enabled) pos.refresh_accumulator();
+        Move move = pos.get_best_move(seconds_per_move, false);
+        pos.make_move(move);
+    }
+    Nnue::Enabled = false;
+    int white_score = pos.white_move ? pos.evaluate() : -pos.evaluate();
+    if (abs(white_score) < 100) return 0;
+    return (white_score > 0) == network_white ? 1 : -1;
+}
+
+void Bench::evaluations(int search_depth, int games, double seconds_per_move) {
+    bool previous_enabled = Nnue::Enabled;
+    long long int nodes[2] = {0, 0};
+    double seconds[2] = {0.0, 0.0};
+    for (const string &fen : Positions) {
+        for (int network = 0; network < 2; ++network) {
+            Nnue::Enabled = network == 1;
+            Position pos = Position(fen);
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            pos.minimax(search_depth, search_depth, -30000, 30000);
+            seconds[network] += seconds_since(begin);
+            nodes[network] += pos.nodes;
+        }
+    }
+    cout << "classical: " << nodes[0] << " nodes in " << seconds[0] << " seconds (" <<
+         (long long int) (nodes[0] / seconds[0]) << " nps)" << endl;
+    cout << "network:   " << nodes[1] << " nodes in " << seconds[1] << " seconds (" <<
+         (long long int) (nodes[1] / seconds[1]) << " nps, " << Nnue::kernel_name() << ")" << endl;
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+    for (int game = 0; game < games; ++game) {
+        int result = play_game(Positions[(game / 2) % Positions.size()], game % 2 == 0, seconds_per_move);
+        result > 0 ? wins++ : (result == 0 ? draws++ : losses++);
+        cout << "game " << game + 1 << ": network " << (game % 2 == 0 ? "white" : "black") << ", " <<
+             (result > 0 ? "won" : (result == 0 ? "draw" : "lost")) << endl;
+    }
+    Nnue::Enabled = previous_enabled;
+    if (games == 0) return;
+    double score = (wins + 0.5 * draws) / games;
+    cout << "network vs classical at " << seconds_per_move << " s/move: +" << wins << " =" << draws << " -" << losses <<
+         " (" << 100 * score << "%";
+    if (score > 0.0 && score < 1.0) cout << ", " << (int) lround(-400 * log10(1 / score - 1)) << " Elo";
+    cout << ")" << endl;
+}
+
+bool Bench::activity_cost(int search_depth) {
+    bool previous_terms = Position::Activity_Terms;
+    double nps[2];
+    for (int terms = 0; terms < 2; ++terms) {
+        Position::Activity_Terms = terms == 1;
+        EvalCache::clear();
+        long long int nodes = 0;
+        double seconds = 0.0;
+        for (const string &fen : Positions) {
+            Position pos = Position(fen);
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            pos.minimax(search_depth, search_depth, -30000, 30000);
+            seconds += seconds_since(begin);
+            nodes += pos.nodes;
+        }
+        nps[terms] = nodes / seconds;
+        cout << (terms ? "with mobility and king safety:    " : "without mobility and king safety: ") << nodes <<
+             " nodes in " << seconds << " seconds (" << (long long int) nps[terms] << " nps)" << endl;
+    }
+    Position::Activity_Terms = previous_terms;
+    EvalCache::clear();
+    double cost = 100 * (1 - nps[1] / nps[0]);
+    bool within = cost < Activity_Budget;
+    cout << "nps cost " << cost << "% (budget " << Activity_Budget << "%): " << (within ? "ok" : "over budget") << endl;
+    return within;
+}
+
+// FENs of the positions along random games from every bench position
+static vector<string> random_game_fens() {
+    vector<string> corpus;
+    unsigned int random = 12345;
+    for (const string &start : Bench::Positions) {
+        Position pos = Position(start);
+        for (int ply = 0; ply < 170; ++ply) {
+            vector<Move> moves = pos.get_all_legal_moves();
+            if (moves.empty()) break;
+            random = random * 1103515245u + 12345u;
+            pos.make_move(moves[(random >> 16) % moves.size()]);
+            corpus.push_back(pos.to_fen());
+        }
+    }
+    return corpus;
+}
+
+bool Bench::fen(int millions) {
+    if (millions < 1) return false;
+    vector<string> corpus = random_game_fens();
+    long long int count = (long long int) millions * 1000000;
+    Position pos;
+    bool round_trip = true;
+    for (const string &fen : corpus) {
+        round_trip = round_trip && pos.set_fen(fen.data(), fen.size()) && pos.to_fen() == fen;
+    }
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    long long int valid = 0;
+    for (long long int i = 0; i < count; ++i) {
+        const string &fen = corpus[i % corpus.size()];
+        valid += pos.set_fen(fen.data(), fen.size());
+    }
+    double parse_time = seconds_since(begin);
+    char buffer[Position::Max_Fen_Length];
+    size_t characters = 0;
+    begin = std::chrono::steady_clock::now();
+    for (long long int i = 0; i < count; ++i) characters += pos.write_fen(buffer);
+    double write_time = seconds_since(begin);
+    begin = std::chrono::steady_clock::now();
+    for (long long int i = 0; i < count; ++i) characters += pos.to_fen().size();
+    double string_time = seconds_since(begin);
+    cout << corpus.size() << " positions from random games, " << count << " conversions each" << endl;
+    cout << "set_fen:   " << count / parse_time / 1e6 << " M positions/s (" << valid << " valid)" << endl;
+    cout << "write_fen: " << count / write_time / 1e6 << " M positions/s (" << characters << " characters)" << endl;
+    cout << "to_fen:    " << count / string_time / 1e6 << " M positions/s" << endl;
+    cout << "round trip " << (round_trip ? "ok" : "FAILED") << endl;
+    return round_trip && valid == count;
+}
+
+bool Bench::packed(int millions, const string &filename) {
+    if (millions < 1) return false;
+    vector<string> corpus = random_game_fens();
+    vector<Position> positions(corpus.size());
+    vector<Packed_Position> records(corpus.size());
+    bool round_trip = true;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        positions[i].set_fen(corpus[i].data(), corpus[i].size());
+        records[i] = PackedPosition::pack(positions[i]);
+        Position unpacked;
+        round_trip = round_trip && PackedPosition::unpack(records[i], unpacked) && unpacked.to_fen() == corpus[i] &&
+                     unpacked.hash == positions[i].hash;
+    }
+    long long int count = (long long int) millions * 1000000;
+    unsigned long long checksum = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (long long int i = 0; i < count; ++i) checksum += PackedPosition::pack(positions[i % positions.size()]).occupancy;
+    double pack_time = seconds_since(begin);
+    Position pos;
+    long long int valid = 0;
+    begin = std::chrono::steady_clock::now();
+    for (long long int i = 0; i < count; ++i) valid += PackedPosition::unpack(records[i % records.size()], pos);
+    double unpack_time = seconds_since(begin);
+    cout << corpus.size() << " positions from random games, " << count << " conversions each" << endl;
+    cout << "pack:   " << count / pack_time / 1e6 << " M positions/s (checksum " << checksum << ")" << endl;
+    cout << "unpack: " << count / unpack_time / 1e6 << " M positions/s (" << valid << " valid)" << endl;
+
+    // the same positions through a file: streamed out and in, then sampled at random through the mapping
+    PackedPosition::Writer writer;
+    bool written = writer.open(filename);
+    begin = std::chrono::steady_clock::now();
+    for (long long int i = 0; i < count && written; ++i) written = writer.write(positions[i % positions.size()]);
+    written = writer.close() && written;
+    double write_time = seconds_since(begin);
+    if (!written) {
+        cout << "could not write " << filename << endl;
+        remove(filename.c_str());
+        return false;
+    }
+    double megabytes = count * sizeof(Packed_Position) / 1e6;
+    cout << "write:  " << megabytes / write_time << " MB/s (" << megabytes << " MB)" << endl;
+    PackedPosition::Reader reader;
+    reader.open(filename);
+    Packed_Position record;
+    long long int read = 0;
+    bool same = true;
+    begin = std::chrono::steady_clock::now();
+    while (reader.next(record)) {
+        same = same && memcmp(&record, &records[read % records.size()], sizeof(record)) == 0;
+        read++;
+    }
+    double read_time = seconds_since(begin);
+    reader.close();
+    cout << "read:   " << megabytes / read_time << " MB/s (" << read << " records)" << endl;
+    PackedPosition::Mapped mapped;
+    bool opened = mapped.open(filename);
+    unsigned long long random = 12345;
+    begin = std::chrono::steady_clock::now();
+    for (long long int i = 0; i < count && opened; ++i) {
+        random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t index = (size_t) ((random >> 16) % mapped.size());
+        same = same && mapped[index].occupancy == records[index % records.size()].occupancy;
+    }
+    double mapped_time = seconds_since(begin);
+    mapped.close();
+    remove(filename.c_str());
+    if (opened) cout << "mapped: " << count / mapped_time / 1e6 << " M random records/s" << endl;
+    bool ok = round_trip && valid == count && read == count && same && opened;
+    cout << "round trip " << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+}
+
+bool Bench::pgn(int games, const string &filename) {
+    if (games < 1) return false;
+    // random games from the bench positions, with comments, NAGs and variations along the main line
+    string text;
+    vector<unsigned long long> final_hashes;
+    vector<size_t> plies;
+    unsigned int random = 12345;
+    long long int moves_written = 0;
+    double write_time = 0.0;
+    for (int game = 0; game < games; ++game) {
+        Position pos = Position(Positions[game % Positions.size()]);
+        text += "[Event \"pgnbench\"]\n[Round \"" + to_string(game) + "\"]\n[SetUp \"1\"]\n[FEN \"" + pos.to_fen() +
+                "\"]\n\n";
+        string result = "*";
+        size_t ply = 0;
+        bool number = true;
+        for (; ply < 170; ++ply) {
+            vector<Move> moves = pos.get_all_legal_moves();
+            if (moves.empty()) {
+                int checker_squares[18];
+                if (pos.get_checkers(checker_squares) > 0) result = pos.white_move ? "0-1" : "1-0";
+                break;
+            }
+            random = random * 1103515245u + 12345u;
+            Move move = moves[(random >> 16) % moves.size()];
+            string move_number = to_string(pos.fullmove_number) + (pos.white_move ? ". " : "... ");
+            if (pos.white_move || number) text += move_number;
+            char san[Position::Max_San_Length];
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            size_t length = pos.write_san(move, san);
+            write_time += seconds_since(begin);
+            text.append(san, length);
+            text += " ";
+            number = false;
+            if (ply % 7 == 3) text += "$1 ";
+            if (ply % 10 == 5) {
+                text += "{ ply " + to_string(ply) + " (not a move) } ";
+                number = true;
+            }
+            if (ply % 15 == 8 && moves.size() > 1) {
+                Move other = moves[(random >> 8) % moves.size()];
+                text += "( " + move_number + pos.to_san(other) + " ) ";
+                number = true;
+            }
+            if (ply % 20 == 19) text += "\n";
+            pos.make_move(move);
+            moves_written++;
+        }
+        text += result + "\n\n";
+        final_hashes.push_back(pos.hash);
+        plies.push_back(ply);
+    }
+    FILE *file = fopen(filename.c_str(), "wb");
+    bool written = file != nullptr && fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (file != nullptr) written = fclose(file) == 0 && written;
+    if (!written) {
+        cout << "could not write " << filename << endl;
+        remove(filename.c_str());
+        return false;
+    }
+    atomic<long long int> mismatches(0);
+    Pgn_Statistics statistics;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool read = Pgn::read_file(filename, [&](const Pgn_Game &game, int) {
+        size_t index = (size_t) stoul(game.tag("Round"));
+        if (!game.valid || index >= final_hashes.size() || game.position.hash != final_hashes[index] ||
+            game.moves.size() != plies[index]) mismatches++;
+    }, statistics);
+    double read_time = seconds_since(begin);
+    remove(filename.c_str());
+    double megabytes = text.size() / 1e6;
+    cout << games << " random games, " << moves_written << " moves, " << megabytes << " MB of PGN" << endl;
+    cout << "write (SAN): " << moves_written / write_time / 1e6 << " M moves/s" << endl;
+    cout << "read (" << omp_get_max_threads() << " threads): " << megabytes / read_time << " MB/s, " <<
+         statistics.games / read_time << " games/s, " << statistics.plies / read_time / 1e6 << " M moves/s" << endl;
+    bool ok = read && statistics.games == games && statistics.invalid == 0 && mismatches == 0;
+    cout << "round trip " << (ok ? "ok" : "FAILED") << " (" << statistics.games << " games, " << statistics.invalid <<
+         " not valid, " << mismatches << " different)" << endl;
+    return ok;
+}
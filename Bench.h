@@ -0,0 +1,37 @@
+#include "Position.h"
+#include <vector>
+#include <string>
+
+#ifndef CHESS_BENCH_H
+#define CHESS_BENCH_H
+
+using namespace std;
+
+// Fixed workload (perft + fixed depth search on a set of positions) used to compare builds and machines.
+class Bench {
+public:
+    static const int Default_Perft_Depth = 4;
+    static const int Default_Search_Depth = 4;
+    static const vector<string> Positions;
+    static void run(int perft_depth, int search_depth);
+    // runs perft_bulk_parallel, SplitPerft and minimax_parallel over Positions with 1, 2, 4, ... max_threads threads and writes
+    // speedup, efficiency, time to depth and search node overhead (relative to one thread) as CSV
+    static bool scaling(int max_threads, int perft_depth, int search_depth, const string &csv_file);
+    // compares the classical evaluation with the loaded network: search nps on Positions at search_depth, then a
+    // match of games (every position with both colours in turn) at a fixed time per move
+    static void evaluations(int search_depth, int games, double seconds_per_move);
+    // search nps over Positions without and with the mobility and king safety terms, checked against the budget
+    static const int Activity_Budget = 25; // percent of search nps the terms may cost
+    static bool activity_cost(int search_depth);
+    // set_fen, write_fen and to_fen in millions of positions per second over positions from random games, and
+    // whether every FEN written reads back to itself
+    static bool fen(int millions);
+    // pack and unpack in millions of positions per second over the same positions, then writing, reading and
+    // randomly sampling a file of them, and whether every record reads back to its position
+    static bool packed(int millions, const string &filename);
+    // writes random games with comments and variations as PGN (SAN moves), reads the file back in parallel and checks
+    // that every game ends in the position it was written from
+    static bool pgn(int games, const string &filename);
+};
+
+#endif //CHESS_BENCH_H
@@ -0,0 +1,302 @@
+#include "DistributedPerft.h"
+#include <iostream>
+#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Work_Unit {
+    int root; // index of the root move
+    int depth; // remaining depth after the moves
+    string moves; // path from the root position, in letter notation
+    bool done;
+    int issued; // how often the unit was handed out
+    std::chrono::steady_clock::time_point started;
+};
+
+struct Worker_Connection {
+    int fd;
+    string buffer; // bytes received but not yet split into lines
+    bool ready;
+    int unit; // unit in progress, -1 if idle
+};
+
+static bool send_line(int fd, const string &line) {
+    string data = line + "\n";
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += (size_t) n;
+    }
+    return true;
+}
+
+// reads what is available and appends complete lines, false once the peer is gone
+static bool receive_lines(int fd, string &buffer, vector<string> &lines) {
+    char chunk[4096];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    buffer.append(chunk, (size_t) n);
+    size_t end;
+    while ((end = buffer.find('\n')) != string::npos) {
+        lines.push_back(buffer.substr(0, end));
+        buffer.erase(0, end + 1);
+    }
+    return true;
+}
+
+static bool is_unix_address(const string &address) {
+    return address.compare(0, 5, "unix:") == 0;
+}
+
+static int open_socket(const string &address, bool listening) {
+    if (is_unix_address(address)) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address.c_str() + 5, sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listening) unlink(addr.sun_path);
+        int ok = listening ? ::bind(fd, (sockaddr *) &addr, sizeof(addr)) : connect(fd, (sockaddr *) &addr, sizeof(addr));
+        if (ok < 0 || (listening && listen(fd, 64) < 0)) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    size_t colon = address.rfind(':');
+    string host = colon == string::npos ? (listening ? "" : "127.0.0.1") : address.substr(0, colon);
+    string port = colon == string::npos ? address : address.substr(colon + 1);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo *result;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) return -1;
+    int fd = -1;
+    for (addrinfo *info = result; info != nullptr; info = info->ai_next) {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0) continue;
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        int ok = listening ? ::bind(fd, info->ai_addr, info->ai_addrlen) : connect(fd, info->ai_addr, info->ai_addrlen);
+        if (ok == 0 && (!listening || listen(fd, 64) == 0)) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+static void split_units(Position &pos, int ply, int split_ply, int depth, int root, const string &path,
+                        vector<Work_Unit> &units) {
+    if (ply == split_ply) {
+        units.push_back({root, depth - ply, path, false, 0, std::chrono::steady_clock::now()});
+        return;
+    }
+    vector<Move> moves = pos.get_all_pseudolegal_moves();
+    pos.filter_legal_moves(moves);
+    for (size_t i = 0; i < moves.size(); ++i) {
+        Move move = moves[i];
+        string move_path = path.empty() ? move.to_letter_string() : path + " " + move.to_letter_string();
+        pos.make_move(move);
+        split_units(pos, ply + 1, split_ply, depth, ply == 0 ? (int) i : root, move_path, units);
+        pos.undo_move(move);
+    }
+}
+
+long long int DistributedPerft::coordinate(Position &root, int depth, int split_ply, const string &address,
+                                           int local_workers, vector<long long int> &root_counts) {
+    vector<Move> root_moves = root.get_all_legal_moves();
+    root_counts.assign(root_moves.size(), 0);
+    if (depth <= 0) return 1;
+    split_ply = max(1, min(split_ply, depth));
+    vector<Work_Unit> units;
+    Position pos = root;
+    split_units(pos, 0, split_ply, depth, 0, "", units);
+    if (units.empty()) return 0;
+
+    int listener = open_socket(address, true);
+    if (listener < 0) {
+        cerr << "could not listen on " << address << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    vector<pid_t> children;
+    string worker_address = address;
+    if (!is_unix_address(address) && address.find(':') == string::npos) worker_address = "127.0.0.1:" + address;
+    for (int i = 0; i < local_workers; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            execl("/proc/self/exe", "Chess", "worker", worker_address.c_str(), (char *) nullptr);
+            _exit(127);
+        }
+        if (pid > 0) children.push_back(pid);
+    }
+
+    string root_fen = root.to_fen();
+
+    deque<int> pending;
+    for (size_t i = 0; i < units.size(); ++i) pending.push_back((int) i);
+    vector<Worker_Connection> workers;
+    size_t completed = 0;
+    long long int total = 0;
+    bool failed = false;
+    while (completed < units.size() && !failed) {
+        vector<pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (Worker_Connection &worker : workers) fds.push_back({worker.fd, POLLIN, 0});
+        poll(fds.data(), fds.size(), 1000);
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0 && send_line(fd, "root " + root_fen)) workers.push_back({fd, "", false, -1});
+            else if (fd >= 0) close(fd);
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Worker_Connection &worker = workers[i - 1];
+            vector<string> lines;
+            if (!receive_lines(worker.fd, worker.buffer, lines)) {
+                // lost worker: its unit goes back to the front of the queue
+                if (worker.unit >= 0 && !units[worker.unit].done) pending.push_front(worker.unit);
+                close(worker.fd);
+                worker.fd = -1;
+                continue;
+            }
+            for (const string &line : lines) {
+                istringstream message(line);
+                string kind;
+                message >> kind;
+                if (kind == "ready") {
+                    worker.ready = true;
+                } else if (kind == "result") {
+                    int id;
+                    long long int count;
+                    message >> id >> count;
+                    if (id >= 0 && id < (int) units.size() && !units[id].done) {
+                        units[id].done = true;
+                        root_counts[units[id].root] += count;
+                        total += count;
+                        completed++;
+                    }
+                    worker.unit = -1;
+                }
+            }
+        }
+        workers.erase(remove_if(workers.begin(), workers.end(), [](const Worker_Connection &worker) {
+            return worker.fd < 0;
+        }), workers.end());
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (Worker_Connection &worker : workers) {
+            if (!worker.ready || worker.unit >= 0) continue;
+            int id = -1;
+            while (!pending.empty() && id < 0) {
+                if (!units[pending.front()].done) id = pending.front();
+                pending.pop_front();
+            }
+            if (id < 0) {
+                // nothing queued: duplicate the oldest unit that has been running for too long
+                for (size_t u = 0; u < units.size(); ++u) {
+                    if (!units[u].done && units[u].issued == 1 &&
+                        std::chrono::duration_cast<std::chrono::seconds>(now - units[u].started).count() > Unit_Timeout) {
+                        id = (int) u;
+                        break;
+                    }
+                }
+            }
+            if (id < 0) continue;
+            units[id].issued++;
+            units[id].started = now;
+            worker.unit = id;
+            if (!send_line(worker.fd, "unit " + to_string(id) + " " + to_string(units[id].depth) + " " + units[id].moves)) {
+                pending.push_front(id);
+                worker.unit = -1;
+            }
+        }
+        if (workers.empty() && !children.empty()) {
+            // all local workers gone and nobody else connected: give up instead of waiting forever
+            bool alive = false;
+            for (pid_t &child : children) {
+                if (child > 0 && waitpid(child, nullptr, WNOHANG) == child) child = -1;
+                if (child > 0) alive = true;
+            }
+            if (!alive) {
+                cerr << "all workers exited with " << units.size() - completed << " units left" << endl;
+                failed = true;
+            }
+        }
+    }
+    for (Worker_Connection &worker : workers) {
+        send_line(worker.fd, "done");
+        close(worker.fd);
+    }
+    close(listener);
+    if (is_unix_address(address)) unlink(address.c_str() + 5);
+    for (pid_t child : children) if (child > 0) waitpid(child, nullptr, 0);
+    return failed ? -1 : total;
+}
+
+int DistributedPerft::work(const string &address, int fail_after) {
+    int fd = -1;
+    for (int attempt = 0; attempt < 100 && fd < 0; ++attempt) {
+        fd = open_socket(address, false);
+        if (fd < 0) this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (fd < 0) {
+        cerr << "could not connect to " << address << endl;
+        return 1;
+    }
+    if (!send_line(fd, "ready")) return 1;
+    Position root = Position();
+    string buffer;
+    int units_done = 0;
+    while (true) {
+        vector<string> lines;
+        if (!receive_lines(fd, buffer, lines)) break;
+        for (const string &line : lines) {
+            if (line.compare(0, 5, "root ") == 0) {
+                root = Position(line.substr(5));
+            } else if (line.compare(0, 5, "unit ") == 0) {
+                if (fail_after > 0 && units_done >= fail_after) {
+                    close(fd);
+                    return 1;
+                }
+                istringstream message(line.substr(5));
+                int id;
+                int depth;
+                message >> id >> depth;
+                Position pos = root;
+                string move_string;
+                while (message >> move_string) {
+                    Move move = Move(move_string);
+                    pos.make_move(move);
+                }
+                long long int count = pos.perft_bulk(depth);
+                if (!send_line(fd, "result " + to_string(id) + " " + to_string(count))) break;
+                units_done++;
+            } else if (line == "done") {
+                close(fd);
+                return 0;
+            }
+        }
+    }
+    close(fd);
+    return 1;
+}
@@ -0,0 +1,30 @@
+#include "Position.h"
+#include <string>
+#include <vector>
+
+#ifndef CHESS_DISTRIBUTEDPERFT_H
+#define CHESS_DISTRIBUTEDPERFT_H
+
+using namespace std;
+
+// Perft spread over several engine processes. The coordinator splits the tree at split_ply into work units
+// (root FEN + move path + remaining depth) and hands them to workers that connect over TCP ("<host>:<port>",
+// coordinator side just "<port>") or a Unix socket ("unix:<path>"). Units of a worker that disconnects go back
+// into the queue, units that take longer than Unit_Timeout are handed out a second time to idle workers, the first
+// result wins. Protocol, one line per message:
+//   worker: "ready", "result <unit> <count>"      coordinator: "root <fen>", "unit <unit> <depth> <moves...>", "done"
+class DistributedPerft {
+public:
+    static const int Default_Split_Ply = 2;
+    static const int Unit_Timeout = 600; // seconds
+
+    // Returns the total (-1 on socket errors), root_counts receives the count per legal root move.
+    // local_workers > 0 starts that many worker processes of this executable on the same machine.
+    static long long int coordinate(Position &root, int depth, int split_ply, const string &address,
+                                    int local_workers, vector<long long int> &root_counts);
+    // Worker main loop (started as "Chess worker <address> [<fail after units>]"), returns the exit code.
+    // fail_after > 0 makes the worker drop its connection after that many units, to test the re-issuing.
+    static int work(const string &address, int fail_after);
+};
+
+#endif //CHESS_DISTRIBUTEDPERFT_H
@@ -0,0 +1,68 @@
+#include "EvalCache.h"
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+
+bool EvalCache::Enabled = true;
+
+static mutex registry_mutex;
+static vector<unique_ptr<EvalCache::Tables>> registry;
+
+EvalCache::Tables *EvalCache::register_thread() {
+    unique_ptr<Tables> tables(new Tables());
+    memset(tables.get(), 0, sizeof(Tables));
+    // key 0 with score 0 is right for the pawn table (no pawns), but not for evaluations
+    for (Eval_Entry &entry : tables->evals) entry.key = ~0ULL;
+    lock_guard<mutex> lock(registry_mutex);
+    registry.push_back(move(tables));
+    return registry.back().get();
+}
+
+void EvalCache::clear() {
+    lock_guard<mutex> lock(registry_mutex);
+    for (auto &tables : registry) {
+        memset(tables->pawns, 0, sizeof(tables->pawns));
+        for (Eval_Entry &entry : tables->evals) entry.key = ~0ULL;
+    }
+}
+
+void EvalCache::reset_statistics() {
+    lock_guard<mutex> lock(registry_mutex);
+    for (auto &tables : registry) {
+        tables->pawn_probes = tables->pawn_hits = 0;
+        tables->eval_probes = tables->eval_hits = 0;
+        tables->lazy_calls = tables->lazy_exits = 0;
+    }
+}
+
+string EvalCache::statistics() {
+    unsigned long long pawn_probes = 0;
+    unsigned long long pawn_hits = 0;
+    unsigned long long eval_probes = 0;
+    unsigned long long eval_hits = 0;
+    unsigned long long lazy_calls = 0;
+    unsigned long long lazy_exits = 0;
+    {
+        lock_guard<mutex> lock(registry_mutex);
+        for (auto &tables : registry) {
+            pawn_probes += tables->pawn_probes;
+            pawn_hits += tables->pawn_hits;
+            eval_probes += tables->eval_probes;
+            eval_hits += tables->eval_hits;
+            lazy_calls += tables->lazy_calls;
+            lazy_exits += tables->lazy_exits;
+        }
+    }
+    if (!Enabled) return "evaluation caches off";
+    ostringstream line;
+    line << fixed << setprecision(1) << "eval cache: " << eval_hits << "/" << eval_probes << " hits (" <<
+         (eval_probes ? 100.0 * eval_hits / eval_probes : 0.0) << "%), pawn table: " << pawn_hits << "/" <<
+         pawn_probes << " hits (" << (pawn_probes ? 100.0 * pawn_hits / pawn_probes : 0.0) << "%), lazy exits: " <<
+         lazy_exits << "/" << lazy_calls << " (" << (lazy_calls ? 100.0 * lazy_exits / lazy_calls : 0.0) << "%)";
+    return line.str();
+}
@@ -0,0 +1,53 @@
+#include <string>
+
+#ifndef CHESS_EVALCACHE_H
+#define CHESS_EVALCACHE_H
+
+using namespace std;
+
+// Per-thread caches for evaluate(): a pawn structure table keyed by the pawn Zobrist key and a table of finished
+// evaluations keyed by the full key (quiescence search reaches the same positions again and again). Both are
+// direct mapped, an entry is simply overwritten. Every thread gets its own tables on first use, so there are no
+// races; the hit counters (and the lazy evaluation exits) are summed over all threads for the report.
+class EvalCache {
+public:
+    static const int Pawn_Entries = 1 << 14;
+    static const int Eval_Entries = 1 << 14;
+
+    struct Pawn_Entry {
+        unsigned long long key;
+        int score; // packed middlegame/endgame score, white's view
+    };
+    struct Eval_Entry {
+        unsigned long long key;
+        int value;
+        bool lazy; // value is the estimate of a lazy exit, only good for a window it lies far outside of
+    };
+    struct Tables {
+        Pawn_Entry pawns[Pawn_Entries];
+        Eval_Entry evals[Eval_Entries];
+        unsigned long long pawn_probes;
+        unsigned long long pawn_hits;
+        unsigned long long eval_probes;
+        unsigned long long eval_hits;
+        unsigned long long lazy_calls; // classical evaluations that could exit early
+        unsigned long long lazy_exits;
+    };
+
+    static bool Enabled;
+
+    static inline Tables &thread_tables() {
+        static thread_local Tables *tables = nullptr;
+        if (tables == nullptr) tables = register_thread();
+        return *tables;
+    }
+    static void clear(); // after the evaluation itself changed, only while no search runs
+    static void reset_statistics();
+    // one line with the hit rates since the last reset
+    static string statistics();
+
+private:
+    static Tables *register_thread();
+};
+
+#endif //CHESS_EVALCACHE_H
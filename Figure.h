@@ -3,6 +3,7 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <cstdint>
 
 using namespace std;
 
@@ -167,6 +168,68 @@ static const int King_Map[] = {
         20, 30, 10,  0,  0, 10, 30, 20
 };
 
+// endgame versions of the maps that change once the heavy pieces are gone: the king belongs in the centre,
+// passed pawns become the main plan
+
+static const int King_End_Map[] = {
+        -50,-40,-30,-20,-20,-30,-40,-50,
+        -30,-20,-10,  0,  0,-10,-20,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-30,  0,  0,  0,  0,-30,-30,
+        -50,-30,-30,-30,-30,-30,-30,-50
+};
+
+static const int Pawn_End_Map[] = {
+        0,  0,  0,  0,  0,  0,  0,  0,
+        80, 80, 80, 80, 80, 80, 80, 80,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        30, 30, 30, 30, 30, 30, 30, 30,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        5,  5,  5,  5,  5,  5,  5,  5,
+        0,  0,  0,  0,  0,  0,  0,  0,
+        0,  0,  0,  0,  0,  0,  0,  0
+};
+
+// game phase by figure type: 24 with all pieces on the board, 0 with kings and pawns only
+static const int Phase_Weights[8] = { 0, 0, 0, 1, 0, 1, 2, 4 };
+static const int Max_Phase = 24;
+
+// pawn structure terms as { middlegame, endgame }
+static const int Doubled_Pawn[2] = { -10, -20 }; // for every pawn beyond the first on a file
+static const int Isolated_Pawn[2] = { -10, -15 };
+static const int Passed_Pawn[2][8] = { // by rows advanced from the start row
+        { 0, 5, 10, 15, 25, 40, 60, 0 },
+        { 0, 10, 15, 25, 45, 70, 110, 0 }
+};
+
+// mobility per safe square (not own, not attacked by an enemy pawn) away from a typical count, by figure type
+static const int Mobility_Weight[2][8] = {
+        { 0, 0, 0, 4, 0, 5, 2, 1 },
+        { 0, 0, 0, 4, 0, 5, 4, 2 }
+};
+static const int Mobility_Average[8] = { 0, 0, 0, 4, 0, 6, 7, 13 };
+
+// king safety: figures attacking the squares around the enemy king add their weight, the sum is scaled by how
+// many attackers take part (a lone attacker is harmless). Middlegame only.
+static const int King_Attack_Weight[8] = { 0, 0, 0, 2, 0, 2, 3, 5 };
+static const int King_Attack_Scale[8] = { 0, 0, 50, 75, 88, 94, 97, 99 }; // percent, by number of attackers
+
+// middlegame and endgame value packed into one int, so that both are updated with a single addition
+inline static int Make_Score(int middlegame, int endgame){
+    return (int) ((unsigned int) endgame << 16) + middlegame;
+}
+
+inline static int Get_Middlegame_Value(int score){
+    return (int16_t) (unsigned int) score;
+}
+
+inline static int Get_Endgame_Value(int score){
+    return (int16_t) ((unsigned int) (score + 0x8000) >> 16);
+}
+
 inline static int Get_Figure_Value(int figure, int index){
     //if (Is_White(figure)) return Values.at(Get_Type(figure));
     //else return -Values.at(Get_Type(figure));
@@ -186,5 +249,13 @@ inline static int Get_Figure_Value(int figure, int index){
     else return -value;
 }
 
+inline static int Get_Figure_End_Value(int figure, int index){
+    int type = Get_Type(figure);
+    if (type != Pawn && type != King) return Get_Figure_Value(figure, index);
+    if (Is_White(figure)) index = 63 - index;
+    int value = (type == Pawn) ? 100 + Pawn_End_Map[index] : 20000 + King_End_Map[index];
+    return Is_White(figure) ? value : -value;
+}
+
 
 #endif //CHESS_FIGURE_H
@@ -16,7 +16,7 @@ Move::Move(string s) {
     this->to = (s[3] - '0' - 1) * 8 + s[2] - 'a';
     this->info = 0;
     if (s.size() > 4){
-        if (s[4] == 'k') this->info = 1 << 26;
+        if (s[4] == 'n' || s[4] == 'k') this->info = 1 << 26; // 'k' as written by earlier versions
         else if (s[4] == 'b') this->info = 2 << 26;
         else if (s[4] == 'r') this->info = 3 << 26;
     }
@@ -40,7 +40,7 @@ string Move::to_letter_string() {
     std::string to_column(1, 'a' + (to & 7));
     string promotion_string;
     if (get_promotion_type() != 0){
-        if (get_promotion_type() == 1) promotion_string = 'k';
+        if (get_promotion_type() == 1) promotion_string = 'n';
         else if (get_promotion_type() == 2) promotion_string = 'b';
         else if (get_promotion_type() == 3) promotion_string = 'r';
     }
@@ -80,7 +80,7 @@ int Move::get_castling_rights() {
 }
 
 int Move::get_halfmove_clock() {
-    return (info & halfmove_clock_mask) >> 12;
+    return ((info & halfmove_clock_mask) >> 12) | ((info & halfmove_clock_high_mask) >> 22);
 }
 
 int Move::get_ep_state() {
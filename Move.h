@@ -19,7 +19,8 @@ public:
     // contains extra info (from least significant bit to most significant): captured figure (5 bits);
     // if it is promotion/en_passant/castling (each 1 bit --> 3 bits);
     // irreversible info about current position: castling rights (4 bits), halfmove clock (6 bits), ep state (8 bits)
-    // and promotion type (what figure the move is promoting to, if it is promotion) (2 bits)
+    // and promotion type (what figure the move is promoting to, if it is promotion) (2 bits),
+    // then the upper 3 bits of the halfmove clock
     string to_number_string();
     string to_letter_string();
     bool operator==(const Move& rhs);
@@ -42,6 +43,7 @@ public:
     static const int halfmove_clock_mask = 0b111111 << 12;
     static const int ep_state_mask = 0b11111111 << 18;
     static const int promotion_type_mask = 0b11 << 26;
+    static const int halfmove_clock_high_mask = 0b111 << 28;
 };
 
 
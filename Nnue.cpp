@@ -0,0 +1,222 @@
+#include "Nnue.h"
+#include "Figure.h"
+#include "EvalCache.h"
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <cmath>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+bool Nnue::Enabled = false;
+
+struct Network_Header {
+    char magic[8];
+    uint32_t inputs;
+    uint32_t hidden;
+    int32_t output_divisor;
+    int32_t output_bias;
+    uint32_t reserved[2];
+};
+
+static const char Magic[8] = { 'C', 'H', 'N', 'N', 'U', 'E', '0', '1' };
+static const size_t Network_Size = sizeof(Network_Header) +
+                                   sizeof(int16_t) * (Nnue::Inputs * Nnue::Hidden + Nnue::Hidden + 2 * Nnue::Hidden);
+
+// the loaded network points into the mapping
+static void *mapping = nullptr;
+static string mapped_file;
+static const int16_t *feature_weights = nullptr;
+static const int16_t *feature_biases = nullptr;
+static const int16_t *output_weights = nullptr;
+static int32_t output_divisor = 1;
+static int32_t output_bias = 0;
+
+bool Nnue::load(const string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size != Network_Size) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, Network_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    const Network_Header *header = (const Network_Header *) data;
+    if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->inputs != (uint32_t) Inputs ||
+        header->hidden != (uint32_t) Hidden || header->output_divisor <= 0) {
+        munmap(data, Network_Size);
+        return false;
+    }
+    if (mapping != nullptr) munmap(mapping, Network_Size);
+    mapping = data;
+    mapped_file = filename;
+    feature_weights = (const int16_t *) ((const char *) data + sizeof(Network_Header));
+    feature_biases = feature_weights + Inputs * Hidden;
+    output_weights = feature_biases + Hidden;
+    output_divisor = header->output_divisor;
+    output_bias = header->output_bias;
+    // the cached evaluations are keyed by the position only, they belong to the previous network
+    EvalCache::clear();
+    return true;
+}
+
+Nnue::Accumulator &Nnue::Accumulator::operator=(const Accumulator &other) {
+    if (this == &other) return *this;
+    if (!Enabled || !other.allocated()) {
+        values.reset();
+    } else {
+        memcpy(allocate(), other.values.get(), sizeof(int16_t) * 2 * Hidden);
+    }
+    return *this;
+}
+
+int16_t (*Nnue::Accumulator::allocate())[Nnue::Hidden] {
+    if (values == nullptr) values.reset(new int16_t[2][Hidden]);
+    return values.get();
+}
+
+bool Nnue::is_loaded() {
+    return mapping != nullptr;
+}
+
+string Nnue::loaded_file() {
+    return mapped_file;
+}
+
+bool Nnue::write_classical(const string &filename) {
+    Network_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.inputs = Inputs;
+    header.hidden = Hidden;
+    header.output_divisor = 1;
+    header.output_bias = 0;
+    vector<int16_t> weights(Inputs * Hidden + Hidden + 2 * Hidden, 0);
+    // every own figure gets a neuron of its own (rooks share with pawns and kings with knights, which never stand on
+    // the same square), weighted value / 4 so that a queen still fits below Clip. Enemy figures are counted by the
+    // other half, kings without their material, which cancels.
+    static const int Types[6] = { Pawn, Knight, Bishop, Rook, Queen, King };
+    static const int Slots[6] = { 0, 1, 2, 4, 3, 5 };
+    for (int piece = 0; piece < 6; ++piece) {
+        for (int square = 0; square < 64; ++square) {
+            int value = Get_Figure_Value(White | Types[piece], square);
+            if (Types[piece] == King) value = value - 20000 + 64;
+            int neuron = (Slots[piece] * 64 + square) % Hidden;
+            weights[(size_t) feature(White | Types[piece], square, 0) * Hidden + neuron] = (int16_t) lround(value / 4.0);
+        }
+    }
+    int16_t *outputs = weights.data() + Inputs * Hidden + Hidden;
+    for (int i = 0; i < Hidden; ++i) {
+        outputs[i] = 4;
+        outputs[Hidden + i] = -4;
+    }
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(weights.data(), sizeof(int16_t), weights.size(), file) == weights.size();
+    ok = fclose(file) == 0 && ok;
+    // the file may be the mapped network, whose weights are now the written ones
+    if (filename == mapped_file) EvalCache::clear();
+    return ok;
+}
+
+// accumulator[i] += sign * row[i]
+static inline void add_row(int16_t *accumulator, const int16_t *row, int sign) {
+#if defined(__AVX2__)
+    for (int i = 0; i < Nnue::Hidden; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (accumulator + i));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (row + i));
+        a = sign > 0 ? _mm256_add_epi16(a, w) : _mm256_sub_epi16(a, w);
+        _mm256_storeu_si256((__m256i *) (accumulator + i), a);
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < Nnue::Hidden; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (accumulator + i));
+        __m128i w = _mm_loadu_si128((const __m128i *) (row + i));
+        a = sign > 0 ? _mm_add_epi16(a, w) : _mm_sub_epi16(a, w);
+        _mm_storeu_si128((__m128i *) (accumulator + i), a);
+    }
+#else
+    for (int i = 0; i < Nnue::Hidden; ++i) accumulator[i] = (int16_t) (accumulator[i] + sign * row[i]);
+#endif
+}
+
+// sum of clamp(accumulator, 0, Clip) * weights
+static inline int clipped_dot(const int16_t *accumulator, const int16_t *weights) {
+#if defined(__AVX2__)
+    __m256i zero = _mm256_setzero_si256();
+    __m256i clip = _mm256_set1_epi16(Nnue::Clip);
+    __m256i sum = zero;
+    for (int i = 0; i < Nnue::Hidden; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (accumulator + i));
+        a = _mm256_min_epi16(_mm256_max_epi16(a, zero), clip);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, _mm256_loadu_si256((const __m256i *) (weights + i))));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i clip = _mm_set1_epi16(Nnue::Clip);
+    __m128i sum = zero;
+    for (int i = 0; i < Nnue::Hidden; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (accumulator + i));
+        a = _mm_min_epi16(_mm_max_epi16(a, zero), clip);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(a, _mm_loadu_si128((const __m128i *) (weights + i))));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int sum = 0;
+    for (int i = 0; i < Nnue::Hidden; ++i) {
+        int a = accumulator[i] < 0 ? 0 : (accumulator[i] > Nnue::Clip ? Nnue::Clip : accumulator[i]);
+        sum += a * weights[i];
+    }
+    return sum;
+#endif
+}
+
+const char *Nnue::kernel_name() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void Nnue::refresh(int16_t accumulator[2][Hidden], const int chessboard[64]) {
+    if (feature_weights == nullptr) return;
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        memcpy(accumulator[perspective], feature_biases, sizeof(int16_t) * Hidden);
+    }
+    for (int square = 0; square < 64; ++square) {
+        if (chessboard[square] != 0) update(accumulator, chessboard[square], square, 1);
+    }
+}
+
+void Nnue::update(int16_t accumulator[2][Hidden], int figure, int square, int sign) {
+    if (feature_weights == nullptr) return;
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        add_row(accumulator[perspective], feature_weights + (size_t) feature(figure, square, perspective) * Hidden, sign);
+    }
+}
+
+int Nnue::evaluate(int16_t accumulator[2][Hidden], bool white_move) {
+    int us = white_move ? 0 : 1;
+    int sum = output_bias + clipped_dot(accumulator[us], output_weights) +
+              clipped_dot(accumulator[1 - us], output_weights + Hidden);
+    return sum / output_divisor;
+}
@@ -0,0 +1,65 @@
+#include <string>
+#include <cstdint>
+#include <memory>
+
+#ifndef CHESS_NNUE_H
+#define CHESS_NNUE_H
+
+using namespace std;
+
+// Efficiently updatable network evaluation, a 768 -> 256 -> 1 design: one input per (own/enemy figure type, square)
+// seen from each side, a 256 wide first layer kept per side for the Position and updated by make_move/undo_move,
+// a clipped ReLU and one output neuron over both halves (side to move first).
+//
+// Network file (little endian), mapped read-only with mmap:
+//   char magic[8] = "CHNNUE01", uint32 inputs = 768, uint32 hidden = 256, int32 output_divisor, int32 output_bias,
+//   uint32 reserved[2], int16 feature_weights[768][256], int16 feature_biases[256], int16 output_weights[512]
+// evaluation = (output_bias + sum clamp(accumulator, 0, Clip) * output_weights) / output_divisor, in centipawns.
+class Nnue {
+public:
+    static const int Inputs = 768;
+    static const int Hidden = 256;
+    static const int Clip = 255;
+    static bool Enabled; // evaluate() uses the network, make_move/undo_move keep the accumulators
+
+    // maps a network file and clears the evaluation caches, only while no search runs
+    static bool load(const string &filename);
+    static bool is_loaded();
+    static string loaded_file();
+    // writes a network that reproduces the classical middlegame material + piece-square score (to 4 centipawns),
+    // for checking the pipeline and as a starting point until a trained network is available
+    static bool write_classical(const string &filename);
+
+    // input index of a figure on a square, seen from perspective (0 = white, 1 = black)
+    static inline int feature(int figure, int square, int perspective) {
+        static const int Piece_Index[8] = { 0, 5, 0, 1, 0, 2, 3, 4 }; // by figure type: P N B R Q K -> 0..5
+        int white = (figure & 16) ? 0 : 1;
+        int relative = white == perspective ? 0 : 1;
+        if (perspective == 1) square ^= 56;
+        return (relative * 6 + Piece_Index[figure & 7]) * 64 + square;
+    }
+    // The first layer of a Position, on the heap so that a Position carries a pointer instead of 1 KB. It is allocated
+    // by the first refresh, and copied with the Position only while the network is enabled; a Position without one
+    // refreshes it from the board when the network first needs it.
+    class Accumulator {
+    public:
+        Accumulator() = default;
+        Accumulator(const Accumulator &other) { *this = other; };
+        Accumulator(Accumulator &&other) = default;
+        Accumulator &operator=(const Accumulator &other);
+        Accumulator &operator=(Accumulator &&other) = default;
+        bool allocated() const { return values != nullptr; };
+        int16_t (*get())[Hidden] { return values.get(); };
+        int16_t (*allocate())[Hidden]; // the storage, allocated if there is none yet
+    private:
+        unique_ptr<int16_t[][Hidden]> values;
+    };
+
+    static void refresh(int16_t accumulator[2][Hidden], const int chessboard[64]);
+    // sign = 1 adds the figure, -1 removes it
+    static void update(int16_t accumulator[2][Hidden], int figure, int square, int sign);
+    static int evaluate(int16_t accumulator[2][Hidden], bool white_move);
+    static const char *kernel_name();
+};
+
+#endif //CHESS_NNUE_H
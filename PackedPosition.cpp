@@ -0,0 +1,131 @@
+#include "PackedPosition.h"
+#include "Figure.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static_assert(sizeof(Packed_Position) == 32, "a packed position takes 32 bytes");
+
+static const int Kinds[8] = { -1, 5, 0, 1, -1, 2, 3, 4 }; // by figure type: P N B R Q K -> 0..5
+// figure code by 4-bit record code, 0 for the unused codes
+static const int Figures[16] = { White | Pawn, White | Knight, White | Bishop, White | Rook, White | Queen, White | King,
+                                 0, 0, Black | Pawn, Black | Knight, Black | Bishop, Black | Rook, Black | Queen,
+                                 Black | King, 0, 0 };
+
+Packed_Position PackedPosition::pack(const Position &pos) {
+    Packed_Position packed;
+    memset(&packed, 0, sizeof(packed));
+    int count = 0;
+    for (int square = 0; square < 64; ++square) {
+        int figure = pos.chessboard[square];
+        if (figure == 0) continue;
+        packed.occupancy |= 1ULL << square;
+        int code = (Is_Black(figure) ? 8 : 0) | Kinds[Get_Type(figure)];
+        packed.figures[count / 2] |= (uint8_t) (code << ((count & 1) * 4));
+        count++;
+    }
+    packed.flags = (uint8_t) ((pos.white_move ? 0 : 1) | (pos.white_can_castle_k << 1) | (pos.white_can_castle_q << 2) |
+                              (pos.black_can_castle_k << 3) | (pos.black_can_castle_q << 4));
+    packed.en_passant = (uint8_t) (pos.possible_en_passant >= 0 && pos.possible_en_passant < 64 ? pos.possible_en_passant : 255);
+    packed.halfmove_clock = (uint16_t) pos.halfmove_clock;
+    packed.fullmove_number = (uint16_t) min(max(pos.fullmove_number, 0), 65535);
+    return packed;
+}
+
+bool PackedPosition::unpack(const Packed_Position &packed, Position &pos) {
+    if (__builtin_popcountll(packed.occupancy) > 32 || (packed.flags >> 5) != 0) return false;
+    if (packed.en_passant != 255 && packed.en_passant >= 64) return false;
+    Board_Setup setup;
+    int count = 0;
+    for (uint64_t rest = packed.occupancy; rest != 0; rest &= rest - 1) {
+        int figure = Figures[(packed.figures[count / 2] >> ((count & 1) * 4)) & 15];
+        count++;
+        if (figure == 0) return false;
+        setup.place(figure, __builtin_ctzll(rest));
+    }
+    return pos.set_board(setup, (packed.flags & 1) == 0, packed.flags >> 1,
+                         packed.en_passant == 255 ? 128 : packed.en_passant, packed.halfmove_clock,
+                         packed.fullmove_number);
+}
+
+bool PackedPosition::Writer::open(const string &filename) {
+    close();
+    file = fopen(filename.c_str(), "wb");
+    failed = file == nullptr;
+    buffer.clear();
+    buffer.reserve(Buffer_Records);
+    return !failed;
+}
+
+bool PackedPosition::Writer::flush() {
+    if (!buffer.empty() && fwrite(buffer.data(), sizeof(Packed_Position), buffer.size(), file) != buffer.size()) {
+        failed = true;
+    }
+    buffer.clear();
+    return !failed;
+}
+
+bool PackedPosition::Writer::write(const Position &pos) {
+    if (file == nullptr) return false;
+    buffer.push_back(pack(pos));
+    return buffer.size() < Buffer_Records || flush();
+}
+
+bool PackedPosition::Writer::close() {
+    if (file == nullptr) return !failed;
+    flush();
+    if (fclose(file) != 0) failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+bool PackedPosition::Reader::open(const string &filename) {
+    close();
+    file = fopen(filename.c_str(), "rb");
+    buffer.resize(Buffer_Records);
+    filled = position = 0;
+    return file != nullptr;
+}
+
+bool PackedPosition::Reader::next(Packed_Position &packed) {
+    if (position == filled) {
+        if (file == nullptr) return false;
+        filled = fread(buffer.data(), sizeof(Packed_Position), buffer.size(), file);
+        position = 0;
+        if (filled == 0) return false;
+    }
+    packed = buffer[position++];
+    return true;
+}
+
+void PackedPosition::Reader::close() {
+    if (file != nullptr) fclose(file);
+    file = nullptr;
+}
+
+bool PackedPosition::Mapped::open(const string &filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0 || info.st_size % sizeof(Packed_Position) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    records = (const Packed_Position *) data;
+    count = (size_t) info.st_size / sizeof(Packed_Position);
+    return true;
+}
+
+void PackedPosition::Mapped::close() {
+    if (records != nullptr) munmap((void *) records, count * sizeof(Packed_Position));
+    records = nullptr;
+    count = 0;
+}
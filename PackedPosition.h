@@ -0,0 +1,85 @@
+#include "Position.h"
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#ifndef CHESS_PACKEDPOSITION_H
+#define CHESS_PACKEDPOSITION_H
+
+using namespace std;
+
+// A position in 32 bytes (little endian), for datasets: the occupied squares as a bitboard, then 4 bits per occupied
+// square in square order (bit 3 black, bits 0-2 P N B R Q K = 0..5, low nibble first), then the state. A file is
+// just the records one after another, so files can be concatenated, split and indexed by record number.
+struct Packed_Position {
+    uint64_t occupancy;
+    uint8_t figures[16];
+    uint8_t flags; // bit 0 black to move, bits 1-4 castling rights K Q k q
+    uint8_t en_passant; // square, 255 for none
+    uint16_t halfmove_clock;
+    uint16_t fullmove_number;
+    uint16_t reserved;
+};
+
+class PackedPosition {
+public:
+    static const size_t Buffer_Records = 1 << 14; // records per read or write call of the streams
+
+    static Packed_Position pack(const Position &pos);
+    // false (and pos unchanged) for a record that is no position: more than 32 figures, bad codes, or a board
+    // Position::set_board does not accept
+    static bool unpack(const Packed_Position &packed, Position &pos);
+
+    // buffered sequential writing
+    class Writer {
+    public:
+        bool open(const string &filename);
+        bool write(const Position &pos);
+        bool close(); // false if anything failed to write
+        ~Writer() { close(); };
+        Writer() = default;
+        Writer(const Writer &) = delete; // owns the file
+        Writer &operator=(const Writer &) = delete;
+    private:
+        FILE *file = nullptr;
+        vector<Packed_Position> buffer;
+        bool failed = false;
+        bool flush();
+    };
+
+    // buffered sequential reading
+    class Reader {
+    public:
+        bool open(const string &filename);
+        bool next(Packed_Position &packed); // false at the end
+        void close();
+        ~Reader() { close(); };
+        Reader() = default;
+        Reader(const Reader &) = delete; // owns the file
+        Reader &operator=(const Reader &) = delete;
+    private:
+        FILE *file = nullptr;
+        vector<Packed_Position> buffer;
+        size_t filled = 0;
+        size_t position = 0;
+    };
+
+    // random access to a whole file through mmap
+    class Mapped {
+    public:
+        bool open(const string &filename); // the file size must be a whole number of records
+        size_t size() const { return count; };
+        const Packed_Position &operator[](size_t index) const { return records[index]; };
+        void close();
+        ~Mapped() { close(); };
+        Mapped() = default;
+        Mapped(const Mapped &) = delete; // owns the mapping
+        Mapped &operator=(const Mapped &) = delete;
+    private:
+        const Packed_Position *records = nullptr;
+        size_t count = 0;
+    };
+};
+
+#endif //CHESS_PACKEDPOSITION_H
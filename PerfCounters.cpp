@@ -0,0 +1,175 @@
+#include "PerfCounters.h"
+#include <omp.h>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <map>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const char *const PerfCounters::Event_Names[PerfCounters::Event_Count] = {
+        "cycles", "instructions", "branches", "branch-misses", "cache-references", "cache-misses", "dTLB-load-misses"
+};
+
+bool PerfCounters::enabled = false;
+
+static mutex region_mutex;
+static map<int, PerfCounters::Reading> region_threads; // omp thread number -> summed reading
+static string open_error; // first reason a counter could not be opened in this region
+
+static thread_local int scope_depth = 0;
+
+#ifdef __linux__
+static int open_event(int event) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    if (event == PerfCounters::Cycles) attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    else if (event == PerfCounters::Instructions) attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    else if (event == PerfCounters::Branches) attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+    else if (event == PerfCounters::Branch_Misses) attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    else if (event == PerfCounters::Cache_References) attr.config = PERF_COUNT_HW_CACHE_REFERENCES;
+    else if (event == PerfCounters::Cache_Misses) attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    else {
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // more events than hardware counters get multiplexed, the enabled/running times let us scale them back
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0); // this thread, any cpu
+}
+#endif
+
+PerfCounters::Thread_Scope::Thread_Scope() {
+    active = enabled;
+    outermost = active && scope_depth++ == 0;
+    thread = omp_get_thread_num();
+    for (int &fd : fds) fd = -1;
+    if (!outermost) return;
+#ifdef __linux__
+    for (int i = 0; i < Event_Count; ++i) {
+        fds[i] = open_event(i);
+        if (fds[i] < 0) {
+            lock_guard<mutex> lock(region_mutex);
+            if (open_error.empty()) open_error = string("perf_event_open: ") + strerror(errno);
+            continue;
+        }
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    lock_guard<mutex> lock(region_mutex);
+    if (open_error.empty()) open_error = "hardware counters are only supported on Linux";
+#endif
+}
+
+PerfCounters::Thread_Scope::~Thread_Scope() {
+    if (active) scope_depth--;
+    if (!outermost) return;
+    Reading reading;
+    for (int i = 0; i < Event_Count; ++i) {
+        reading.values[i] = 0.0;
+        reading.valid[i] = false;
+#ifdef __linux__
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        unsigned long long data[3]; // value, time enabled, time running
+        if (read(fds[i], data, sizeof(data)) == sizeof(data) && data[2] != 0) {
+            reading.values[i] = (double) data[0] * ((double) data[1] / data[2]);
+            reading.valid[i] = true;
+        }
+        close(fds[i]);
+#endif
+    }
+    add_reading(thread, reading);
+}
+
+void PerfCounters::add_reading(int thread, const Reading &reading) {
+    lock_guard<mutex> lock(region_mutex);
+    auto it = region_threads.find(thread);
+    if (it == region_threads.end()) {
+        region_threads[thread] = reading;
+        return;
+    }
+    for (int i = 0; i < Event_Count; ++i) {
+        it->second.values[i] += reading.values[i];
+        it->second.valid[i] = it->second.valid[i] || reading.valid[i];
+    }
+}
+
+void PerfCounters::begin_region() {
+    lock_guard<mutex> lock(region_mutex);
+    region_threads.clear();
+    open_error.clear();
+}
+
+static void print_reading(const string &label, const PerfCounters::Reading &reading) {
+    cout << left << setw(8) << label << right;
+    for (int i = 0; i < PerfCounters::Event_Count; ++i) {
+        if (reading.valid[i]) cout << setw(18) << (long long int) reading.values[i];
+        else cout << setw(18) << "n/a";
+    }
+    const double *v = reading.values;
+    const bool *ok = reading.valid;
+    cout << fixed << setprecision(2);
+    if (ok[PerfCounters::Cycles] && ok[PerfCounters::Instructions] && v[PerfCounters::Cycles] > 0)
+        cout << setw(8) << v[PerfCounters::Instructions] / v[PerfCounters::Cycles];
+    else cout << setw(8) << "n/a";
+    if (ok[PerfCounters::Branches] && ok[PerfCounters::Branch_Misses] && v[PerfCounters::Branches] > 0)
+        cout << setw(9) << 100.0 * v[PerfCounters::Branch_Misses] / v[PerfCounters::Branches] << "%";
+    else cout << setw(10) << "n/a";
+    if (ok[PerfCounters::Cache_References] && ok[PerfCounters::Cache_Misses] && v[PerfCounters::Cache_References] > 0)
+        cout << setw(9) << 100.0 * v[PerfCounters::Cache_Misses] / v[PerfCounters::Cache_References] << "%";
+    else cout << setw(10) << "n/a";
+    cout << endl;
+}
+
+void PerfCounters::print_report(double seconds) {
+    if (!enabled) return;
+    lock_guard<mutex> lock(region_mutex);
+    Reading total;
+    bool any_valid = false;
+    for (int i = 0; i < Event_Count; ++i) {
+        total.values[i] = 0.0;
+        total.valid[i] = false;
+        for (auto &thread : region_threads) {
+            total.values[i] += thread.second.values[i];
+            total.valid[i] = total.valid[i] || thread.second.valid[i];
+        }
+        any_valid = any_valid || total.valid[i];
+    }
+    if (!any_valid) {
+        cout << "hardware counters unavailable (" << (open_error.empty() ? "nothing measured" : open_error) << ")" << endl;
+        return;
+    }
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << "hardware counters (" << region_threads.size() << " thread(s), " << seconds << " seconds";
+    if (!open_error.empty()) cout << ", some events unavailable: " << open_error;
+    cout << ")" << endl;
+    cout << left << setw(8) << "thread" << right;
+    for (const char *name : Event_Names) cout << setw(18) << name;
+    cout << setw(8) << "IPC" << setw(10) << "br-miss" << setw(10) << "$-miss" << endl;
+    for (auto &thread : region_threads) {
+        print_reading(to_string(thread.first), thread.second);
+        cout.flags(flags);
+        cout.precision(precision);
+    }
+    if (region_threads.size() > 1) print_reading("total", total);
+    cout.flags(flags);
+    cout.precision(precision);
+}
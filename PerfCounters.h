@@ -0,0 +1,51 @@
+#include <string>
+#include <vector>
+
+#ifndef CHESS_PERFCOUNTERS_H
+#define CHESS_PERFCOUNTERS_H
+
+using namespace std;
+
+// Hardware performance counters (Linux perf_event_open), opened per thread around a measured region.
+// If the kernel refuses the counters (no PMU, perf_event_paranoid, containers, other OS) the report says so
+// and the engine runs on unchanged.
+class PerfCounters {
+public:
+    static const int Cycles = 0;
+    static const int Instructions = 1;
+    static const int Branches = 2;
+    static const int Branch_Misses = 3;
+    static const int Cache_References = 4;
+    static const int Cache_Misses = 5;
+    static const int DTLB_Misses = 6;
+    static const int Event_Count = 7;
+    static const char *const Event_Names[Event_Count];
+
+    struct Reading {
+        double values[Event_Count];
+        bool valid[Event_Count];
+    };
+
+    // Opens the counters for the calling thread for its lifetime and adds them to the current region.
+    // Nested scopes on the same thread are no-ops, so a command can wrap its whole work in one scope on the main
+    // thread while the parallel regions it calls open one scope per worker.
+    class Thread_Scope {
+    public:
+        Thread_Scope();
+        ~Thread_Scope();
+    private:
+        bool active;
+        bool outermost;
+        int thread;
+        int fds[Event_Count];
+    };
+
+    static bool enabled; // toggled by the 'hw' command, scopes do nothing while false
+    static void begin_region();
+    static void print_report(double seconds);
+
+private:
+    static void add_reading(int thread, const Reading &reading);
+};
+
+#endif //CHESS_PERFCOUNTERS_H
@@ -0,0 +1,67 @@
+#include "PerftCheckpoint.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+PerftCheckpoint::PerftCheckpoint(const string &filename, unsigned long long hash, int depth,
+                                 const vector<string> &units)
+        : filename(filename), units(units.size()), start(std::chrono::steady_clock::now()) {
+    if (filename.empty()) return;
+    ostringstream header;
+    header << "perft checkpoint " << hex << hash << dec << " depth " << depth;
+    ifstream previous(filename);
+    string line;
+    if (previous && getline(previous, line)) {
+        if (line == header.str()) {
+            // a line without its newline was cut off by the interruption, its move is computed again
+            while (getline(previous, line) && !previous.eof()) {
+                istringstream fields(line);
+                string unit;
+                long long int count;
+                string rest;
+                if (fields >> unit >> count && !(fields >> rest) && count >= 0 &&
+                    find_if(units.begin(), units.end(), [&](const string &name) { return name == unit; }) != units.end()) {
+                    finished[unit] = count;
+                }
+            }
+        } else {
+            cerr << filename << " belongs to another position or depth, starting over" << endl;
+        }
+    }
+    previous.close();
+    // rewritten rather than appended to, so that a partial last line does not stay in the file
+    file.open(filename, ios::trunc);
+    if (!file) {
+        cerr << "could not write checkpoint " << filename << endl;
+        return;
+    }
+    file << header.str() << "\n";
+    for (auto &entry : finished) file << entry.first << " " << entry.second << "\n";
+    file.flush();
+    if (!finished.empty()) cerr << "resuming: " << finished.size() << " of " << units.size() << " root moves done" << endl;
+}
+
+bool PerftCheckpoint::find(const string &unit, long long int &count) const {
+    auto entry = finished.find(unit);
+    if (entry == finished.end()) return false;
+    count = entry->second;
+    return true;
+}
+
+void PerftCheckpoint::record(const string &unit, long long int count) {
+    lock_guard<mutex> lock(file_mutex);
+    if (file.is_open()) {
+        file << unit << " " << count << "\n";
+        file.flush();
+    }
+    done++;
+    double elapsed = (double) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count() / 1000;
+    size_t left = units - finished.size() - done;
+    // root moves differ a lot in size, so this is a rough estimate
+    double eta = elapsed / done * left;
+    cerr << "[" << finished.size() + done << "/" << units << "] " << unit << " " << count << ", " << elapsed <<
+         " s elapsed, eta " << eta << " s" << endl;
+}
@@ -0,0 +1,35 @@
+#include <string>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <chrono>
+#include <vector>
+
+#ifndef CHESS_PERFTCHECKPOINT_H
+#define CHESS_PERFTCHECKPOINT_H
+
+using namespace std;
+
+// Progress of a root-split perft. Every finished root move is appended to the checkpoint file (if one is given)
+// and flushed at once; a later run of the same position and depth with the same file skips those moves.
+// Progress and an ETA go to stderr.
+class PerftCheckpoint {
+public:
+    PerftCheckpoint(const string &filename, unsigned long long hash, int depth, const vector<string> &units);
+    // count of a root move finished by an earlier run
+    bool find(const string &unit, long long int &count) const;
+    // thread-safe
+    void record(const string &unit, long long int count);
+    size_t resumed_units() const { return finished.size(); };
+
+private:
+    string filename;
+    ofstream file;
+    map<string, long long int> finished; // loaded from the file, only units of this run
+    mutex file_mutex;
+    size_t units;
+    size_t done = 0; // finished in this run
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //CHESS_PERFTCHECKPOINT_H
@@ -0,0 +1,110 @@
+#include "PerftSuite.h"
+#include "Position.h"
+#include <omp.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+struct Suite_Job {
+    int line; // position number in the file
+    string fen;
+    int depth;
+    long long int expected;
+    long long int result;
+    double seconds;
+};
+
+bool PerftSuite::run(const string &filename, int max_depth, bool bulk) {
+    ifstream file(filename);
+    if (!file) {
+        cout << "could not open " << filename << endl;
+        return false;
+    }
+    vector<Suite_Job> jobs;
+    string line;
+    int line_number = 0;
+    int positions = 0;
+    int errors = 0; // lines that could not be read
+    Position parsed;
+    while (getline(file, line)) {
+        line_number++;
+        if (line.empty() || line[0] == '#') continue;
+        size_t separator = line.find(';');
+        if (separator == string::npos) continue;
+        string fen = line.substr(0, separator);
+        fen.erase(fen.find_last_not_of(" \t") + 1);
+        positions++;
+        if (!parsed.set_fen(fen.data(), fen.size())) {
+            cout << "line " << line_number << ": not a valid FEN: " << fen << endl;
+            errors++;
+            continue;
+        }
+        istringstream fields(line.substr(separator));
+        string field;
+        while (getline(fields, field, ';')) {
+            istringstream entry(field);
+            string depth_token;
+            long long int expected;
+            if (!(entry >> depth_token >> expected) || depth_token.size() < 2 || depth_token[0] != 'D') continue;
+            istringstream depth_number(depth_token.substr(1));
+            int depth;
+            if (!(depth_number >> depth) || !depth_number.eof() || depth < 1) {
+                cout << "line " << line_number << ": not a depth of 1 or more: " << depth_token << endl;
+                errors++;
+                continue;
+            }
+            if (depth <= max_depth) jobs.push_back({positions, fen, depth, expected, -1, 0.0});
+        }
+    }
+    // biggest subtrees first, so the small ones fill the gaps at the end
+    vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    sort(order.begin(), order.end(), [&jobs](size_t lhs, size_t rhs) { return jobs[lhs].expected > jobs[rhs].expected; });
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    long long int job_count = (long long int) order.size();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (long long int i = 0; i < job_count; ++i) {
+        Suite_Job &job = jobs[order[i]];
+        Position pos;
+        pos.set_fen(job.fen.data(), job.fen.size());
+        std::chrono::steady_clock::time_point job_begin = std::chrono::steady_clock::now();
+        job.result = bulk ? pos.perft_bulk(job.depth) : pos.perft(job.depth);
+        std::chrono::steady_clock::time_point job_end = std::chrono::steady_clock::now();
+        job.seconds = (double) std::chrono::duration_cast<std::chrono::microseconds>(job_end - job_begin).count() / 1000000;
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double wall_seconds = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000;
+
+    int failed = 0;
+    long long int nodes = 0;
+    double cpu_seconds = 0.0;
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << left << setw(5) << "pos" << setw(7) << "depth" << right << setw(14) << "expected" << setw(14) << "nodes" <<
+         setw(7) << "" << setw(11) << "seconds" << setw(14) << "nps" << "  fen" << endl;
+    for (Suite_Job &job : jobs) {
+        bool passed = job.result == job.expected;
+        if (!passed) failed++;
+        nodes += job.result;
+        cpu_seconds += job.seconds;
+        cout << left << setw(5) << job.line << setw(7) << job.depth << right << setw(14) << job.expected <<
+             setw(14) << job.result << setw(7) << (passed ? "pass" : "FAIL") << setw(11) << fixed << setprecision(4) << job.seconds <<
+             setw(14) << (job.seconds > 0 ? (long long int) (job.result / job.seconds) : 0) << "  " << job.fen << endl;
+    }
+    cout.flags(flags);
+    cout.precision(precision);
+    cout << endl;
+    cout << jobs.size() - failed << "/" << jobs.size() << " passed (" << positions << " positions, " <<
+         (bulk ? "bulk perft" : "perft") << ", up to depth " << max_depth << ")" << endl;
+    if (errors > 0) cout << errors << " errors in " << filename << endl;
+    cout << nodes << " nodes in " << wall_seconds << " seconds wall / " << cpu_seconds << " seconds cpu (" <<
+         (wall_seconds > 0 ? (long long int) (nodes / wall_seconds) : 0) << " nps, " << omp_get_max_threads() <<
+         " threads)" << endl;
+    return failed == 0 && errors == 0;
+}
@@ -0,0 +1,16 @@
+#include <string>
+
+#ifndef CHESS_PERFTSUITE_H
+#define CHESS_PERFTSUITE_H
+
+using namespace std;
+
+// Runs an EPD perft suite (lines of "<FEN> ;D1 <count> ;D2 <count> ...") and checks every count.
+// The (position, depth) pairs are run in parallel, biggest first, each on a single thread.
+class PerftSuite {
+public:
+    // bulk = count with perft_bulk instead of the leaf-visiting perft. Returns true if every line could be read and every count matched.
+    static bool run(const string &filename, int max_depth, bool bulk);
+};
+
+#endif //CHESS_PERFTSUITE_H
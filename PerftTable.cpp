@@ -0,0 +1,68 @@
+#include "PerftTable.h"
+#include "Trace.h"
+#include <new>
+#include <cstdint>
+#include <unistd.h>
+
+using namespace std;
+
+PerftTable::~PerftTable() {
+    delete[] memory;
+}
+
+bool PerftTable::resize(size_t megabytes) {
+    Trace::Span span("perft table resize", "MB", (long long int) megabytes);
+    if (megabytes > max_mb()) return false;
+    unsigned char *allocated = nullptr;
+    size_t count = 0;
+    if (megabytes > 0) {
+        count = 1;
+        while (count * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024) count *= 2;
+        allocated = new (nothrow) unsigned char[count * sizeof(Bucket) + alignof(Bucket)];
+        if (allocated == nullptr) return false;
+    }
+    delete[] memory;
+    memory = allocated;
+    buckets = nullptr;
+    bucket_count = 0;
+    if (megabytes == 0) return true;
+    uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+    address = (address + alignof(Bucket) - 1) & ~(uintptr_t) (alignof(Bucket) - 1);
+    buckets = reinterpret_cast<Bucket *>(address);
+    for (size_t i = 0; i < count; ++i) new (&buckets[i]) Bucket();
+    bucket_count = count;
+    return true;
+}
+
+size_t PerftTable::max_mb() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    if (pages <= 0 || page_size <= 0) return 1024;
+    return (size_t) pages / 2 * (size_t) page_size / (1024 * 1024);
+}
+
+void PerftTable::clear() {
+    Trace::Span span("perft table clear");
+    long long int count = (long long int) bucket_count;
+#pragma omp parallel for schedule(static)
+    for (long long int i = 0; i < count; ++i) {
+        for (Entry &entry : buckets[i].entries) {
+            entry.data.store(0, memory_order_relaxed);
+            entry.check.store(0, memory_order_relaxed);
+        }
+    }
+}
+
+size_t PerftTable::size_mb() {
+    return bucket_count * sizeof(Bucket) / (1024 * 1024);
+}
+
+int PerftTable::hashfull() {
+    if (bucket_count == 0) return 0;
+    size_t sample = bucket_count < 250 ? bucket_count : 250;
+    int used = 0;
+    for (size_t i = 0; i < sample; ++i) {
+        for (Entry &entry : buckets[i].entries) if (entry.data.load(memory_order_relaxed) != 0) used++;
+    }
+    return (int) (used * 1000 / (sample * Bucket_Size));
+}
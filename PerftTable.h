@@ -0,0 +1,81 @@
+#include <atomic>
+#include <cstddef>
+
+#ifndef CHESS_PERFTTABLE_H
+#define CHESS_PERFTTABLE_H
+
+using namespace std;
+
+// Hash table of perft subtree counts, keyed by Zobrist key and depth, shared by all perft threads without locks.
+// Every entry stores (key ^ data) next to data, so a probe only hits if the full 64 bit key matches and both
+// words come from the same store (a torn concurrent write just looks like a miss).
+class PerftTable {
+public:
+    static const int Bucket_Size = 4; // 4 entries of 16 bytes = one cache line
+
+    struct Entry {
+        atomic<unsigned long long> check;
+        atomic<unsigned long long> data; // count << 8 | depth
+    };
+    struct alignas(64) Bucket {
+        Entry entries[Bucket_Size];
+    };
+
+    PerftTable() : memory(nullptr), buckets(nullptr), bucket_count(0) {};
+    ~PerftTable();
+    // rounded down to a power of two, 0 disables the table; false and the table unchanged if the size is above
+    // max_mb() or the memory could not be allocated
+    bool resize(size_t megabytes);
+    static size_t max_mb(); // half the physical memory
+    void clear();
+    size_t size_mb();
+    int hashfull(); // used entries per mille, sampled from the first buckets
+
+    inline bool enabled() {
+        return bucket_count != 0;
+    }
+
+    inline bool probe(unsigned long long key, int depth, long long int &count) {
+        if (bucket_count == 0) return false;
+        Bucket &bucket = buckets[key & (bucket_count - 1)];
+        for (Entry &entry : bucket.entries) {
+            unsigned long long data = entry.data.load(memory_order_relaxed);
+            unsigned long long check = entry.check.load(memory_order_relaxed);
+            if ((check ^ data) == key && (int) (data & 0xFF) == depth) {
+                count = (long long int) (data >> 8);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void store(unsigned long long key, int depth, long long int count) {
+        if (bucket_count == 0) return;
+        Bucket &bucket = buckets[key & (bucket_count - 1)];
+        // replace the same position if present, otherwise the entry with the smallest subtree (empty ones have depth 0)
+        Entry *replace = &bucket.entries[0];
+        int replace_depth = 256;
+        for (Entry &entry : bucket.entries) {
+            unsigned long long data = entry.data.load(memory_order_relaxed);
+            int entry_depth = (int) (data & 0xFF);
+            if ((entry.check.load(memory_order_relaxed) ^ data) == key && entry_depth == depth) {
+                replace = &entry;
+                break;
+            }
+            if (entry_depth < replace_depth) {
+                replace = &entry;
+                replace_depth = entry_depth;
+            }
+        }
+        unsigned long long data = ((unsigned long long) count << 8) | (unsigned long long) depth;
+        replace->data.store(data, memory_order_relaxed);
+        replace->check.store(key ^ data, memory_order_relaxed);
+    }
+
+private:
+    unsigned char *memory;
+    Bucket *buckets;
+    size_t bucket_count;
+};
+
+#endif //CHESS_PERFTTABLE_H
@@ -0,0 +1,218 @@
+#include "Pgn.h"
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <omp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t Min_Chunk_Size = 1 << 20;
+
+string Pgn_Game::tag(const string &name) const {
+    for (const Pgn_Tag &pair : tags) {
+        if (pair.name_length == name.size() && memcmp(pair.name, name.data(), name.size()) == 0) {
+            return string(pair.value, pair.value_length);
+        }
+    }
+    return "";
+}
+
+void Pgn_Statistics::add(const Pgn_Statistics &other) {
+    games += other.games;
+    plies += other.plies;
+    invalid += other.invalid;
+    bytes += other.bytes;
+}
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline void skip_line(const char *&cursor, const char *end) {
+    const char *newline = (const char *) memchr(cursor, '\n', (size_t) (end - cursor));
+    cursor = newline != nullptr ? newline + 1 : end;
+}
+
+// whitespace and % escape lines
+static inline void skip_spaces(const char *&cursor, const char *end, const char *file_begin) {
+    while (cursor < end) {
+        if (is_space(*cursor)) cursor++;
+        else if (*cursor == '%' && (cursor == file_begin || cursor[-1] == '\n')) skip_line(cursor, end);
+        else break;
+    }
+}
+
+static inline bool is_result(const char *token, size_t length) {
+    return (length == 1 && *token == '*') || (length == 3 && (memcmp(token, "1-0", 3) == 0 || memcmp(token, "0-1", 3) == 0)) ||
+           (length == 7 && memcmp(token, "1/2-1/2", 7) == 0);
+}
+
+// reads a tag pair from '[' to the end of its line
+static void read_tag(const char *&cursor, const char *end, Pgn_Game &game) {
+    const char *line_end = (const char *) memchr(cursor, '\n', (size_t) (end - cursor));
+    if (line_end == nullptr) line_end = end;
+    cursor++;
+    while (cursor < line_end && is_space(*cursor)) cursor++;
+    Pgn_Tag pair;
+    pair.name = cursor;
+    while (cursor < line_end && (isalnum((unsigned char) *cursor) || *cursor == '_')) cursor++;
+    pair.name_length = (size_t) (cursor - pair.name);
+    while (cursor < line_end && is_space(*cursor)) cursor++;
+    if (pair.name_length > 0 && cursor < line_end && *cursor == '"') {
+        pair.value = ++cursor;
+        while (cursor < line_end && *cursor != '"') cursor += *cursor == '\\' ? 2 : 1;
+        if (cursor < line_end) {
+            pair.value_length = (size_t) (cursor - pair.value);
+            game.tags.push_back(pair);
+        }
+    }
+    cursor = line_end;
+}
+
+bool Pgn::read_game(const char *&cursor, const char *end, const char *file_begin, Pgn_Game &game) {
+    static const Position start_position;
+    skip_spaces(cursor, end, file_begin);
+    if (cursor == end) return false;
+    game.tags.clear();
+    game.moves.clear();
+    game.result.clear();
+    game.valid = true;
+    game.offset = (size_t) (cursor - file_begin);
+    while (cursor < end && *cursor == '[') {
+        read_tag(cursor, end, game);
+        skip_spaces(cursor, end, file_begin);
+    }
+    game.start = start_position;
+    for (const Pgn_Tag &pair : game.tags) {
+        if (pair.name_length == 3 && memcmp(pair.name, "FEN", 3) == 0 && !game.start.set_fen(pair.value, pair.value_length)) {
+            game.valid = false;
+        }
+    }
+    game.position = game.start;
+    int depth = 0; // of the variations
+    while (cursor < end) {
+        char c = *cursor;
+        bool line_start = cursor == file_begin || cursor[-1] == '\n';
+        if (is_space(c)) {
+            cursor++;
+        } else if (c == '{') {
+            const char *close = (const char *) memchr(cursor, '}', (size_t) (end - cursor));
+            cursor = close != nullptr ? close + 1 : end;
+        } else if (c == ';' || (c == '%' && line_start)) {
+            skip_line(cursor, end);
+        } else if (c == '(') {
+            depth++;
+            cursor++;
+        } else if (c == ')') {
+            depth = max(depth - 1, 0);
+            cursor++;
+        } else if (c == '[' && line_start) {
+            break; // the tags of the next game, this one has no result
+        } else {
+            const char *token = cursor;
+            while (cursor < end && !is_space(*cursor) && *cursor != '{' && *cursor != '(' && *cursor != ')' &&
+                   *cursor != ';') cursor++;
+            size_t length = (size_t) (cursor - token);
+            if (depth > 0 || *token == '$') continue;
+            if (is_result(token, length)) {
+                game.result.assign(token, length);
+                break;
+            }
+            // move number, maybe with the move after it: 12. 12... 12.e4
+            if (*token >= '1' && *token <= '9') {
+                while (length > 0 && ((*token >= '0' && *token <= '9') || *token == '.')) {
+                    token++;
+                    length--;
+                }
+                if (length == 0) continue;
+            }
+            Move move;
+            if (game.valid && game.position.parse_san(token, length, move)) {
+                game.position.make_move(move);
+                game.moves.push_back(move);
+            } else {
+                game.valid = false;
+            }
+        }
+    }
+    return true;
+}
+
+static Pgn_Statistics read_games(const char *begin, const char *end, const char *file_begin, Pgn_Game &game,
+                                 int thread, const Pgn::Visitor &visit) {
+    Pgn_Statistics statistics;
+    statistics.bytes = (size_t) (end - begin);
+    const char *cursor = begin;
+    while (Pgn::read_game(cursor, end, file_begin, game)) {
+        statistics.games++;
+        statistics.plies += (long long int) game.moves.size();
+        if (!game.valid) statistics.invalid++;
+        visit(game, thread);
+    }
+    return statistics;
+}
+
+Pgn_Statistics Pgn::read(const char *begin, const char *end, const Visitor &visit) {
+    Pgn_Game game;
+    return read_games(begin, end, begin, game, 0, visit);
+}
+
+// the first tag line after an empty line at or after from, end if there is none
+static const char *next_game(const char *from, const char *begin, const char *end) {
+    const char *cursor = from;
+    while (cursor < end) {
+        const char *newline = (const char *) memchr(cursor, '\n', (size_t) (end - cursor));
+        if (newline == nullptr) return end;
+        cursor = newline + 1;
+        if (cursor == end || *cursor != '[') continue;
+        const char *previous = newline - 1;
+        while (previous >= begin && (*previous == '\r' || *previous == ' ' || *previous == '\t')) previous--;
+        if (previous < begin || *previous == '\n') return cursor;
+    }
+    return end;
+}
+
+bool Pgn::read_file(const string &filename, const Visitor &visit, Pgn_Statistics &statistics) {
+    statistics = Pgn_Statistics();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t) info.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    const char *begin = (const char *) data;
+    const char *end = begin + size;
+    // a few chunks per thread so that threads with short games pick up more of them
+    int threads = omp_get_max_threads();
+    size_t chunk_count = max((size_t) 1, min((size_t) threads * 4, size / Min_Chunk_Size));
+    vector<const char *> bounds(chunk_count + 1);
+    bounds[0] = begin;
+    for (size_t i = 1; i < chunk_count; ++i) bounds[i] = max(bounds[i - 1], next_game(begin + i * (size / chunk_count), begin, end));
+    bounds[chunk_count] = end;
+    vector<Pgn_Statistics> chunk_statistics(chunk_count);
+    #pragma omp parallel num_threads(threads)
+    {
+        Pgn_Game game;
+        int thread = omp_get_thread_num();
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t i = 0; i < chunk_count; ++i) {
+            chunk_statistics[i] = read_games(bounds[i], bounds[i + 1], begin, game, thread, visit);
+        }
+    }
+    for (const Pgn_Statistics &chunk : chunk_statistics) statistics.add(chunk);
+    munmap(data, size);
+    return true;
+}
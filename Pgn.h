@@ -0,0 +1,58 @@
+#include "Position.h"
+#include <string>
+#include <vector>
+#include <functional>
+
+#ifndef CHESS_PGN_H
+#define CHESS_PGN_H
+
+using namespace std;
+
+// A tag pair of a game, pointing into the text of the file (the value without the quotes, escapes left as they are).
+struct Pgn_Tag {
+    const char *name;
+    size_t name_length;
+    const char *value;
+    size_t value_length;
+};
+
+struct Pgn_Game {
+    vector<Pgn_Tag> tags;
+    Position start; // the FEN tag or the start position
+    Position position; // after the moves
+    vector<Move> moves; // the main line; up to the first move that could not be read if the game is not valid
+    string result; // "1-0", "0-1", "1/2-1/2", "*" or empty if the game text ends without one
+    bool valid;
+    size_t offset; // of the first tag in the file
+
+    string tag(const string &name) const; // empty if the game has no such tag
+};
+
+struct Pgn_Statistics {
+    long long int games;
+    long long int plies;
+    long long int invalid; // games with a move that is not legal or not SAN, or a FEN tag that is not valid
+    size_t bytes;
+
+    Pgn_Statistics() : games(0), plies(0), invalid(0), bytes(0) {};
+    void add(const Pgn_Statistics &other);
+};
+
+// Reads games in PGN export or import format: tag pairs, then the movetext with move numbers, SAN moves, comments
+// ({...} and ; to the end of the line), variations (skipped, they may be nested), NAGs and the result. Lines starting
+// with % are ignored. Every move is checked against the legal moves, so the moves of a game can be made on start.
+class Pgn {
+public:
+    typedef function<void(const Pgn_Game &game, int thread)> Visitor;
+
+    // reads the next game from cursor, false if there is none before end
+    static bool read_game(const char *&cursor, const char *end, const char *file_begin, Pgn_Game &game);
+    // every game of the text, in order, on the calling thread
+    static Pgn_Statistics read(const char *begin, const char *end, const Visitor &visit);
+    // every game of a file, mapped with mmap and cut into chunks that are read in parallel: a chunk starts at a tag
+    // line after an empty line. The visitor is called from all threads at once, in no particular order of the games.
+    // false if the file cannot be mapped.
+    static bool read_file(const string &filename, const Visitor &visit, Pgn_Statistics &statistics);
+};
+
+#endif //CHESS_PGN_H
@@ -0,0 +1,33 @@
+#include "Position.h"
+#include <string>
+#include <vector>
+
+#ifndef CHESS_POLYGLOTBOOK_H
+#define CHESS_POLYGLOTBOOK_H
+
+using namespace std;
+
+// Opening book in the Polyglot .bin format, mapped read-only with mmap: 16-byte big-endian entries
+//   uint64 key, uint16 move, uint16 weight, uint32 learn
+// sorted by key. The key of a position is the Polyglot hash (not our Zobrist key): the xor of Random64 entries for
+// every figure (64 * kind + square, kind = 2 * piece + white with P N B R Q K = 0..5), the castling rights (768..771),
+// the en passant file if a pawn can take (772..779) and white to move (780), from the 781 Random64 numbers of the
+// Polyglot sources.
+// Move bits: to file 0-2, to row 3-5, from file 6-8, from row 9-11, promotion 12-14 (N B R Q = 1..4);
+// castling is written as the king taking its own rook.
+class PolyglotBook {
+public:
+    static const int Key_Count = 781;
+    static bool Enabled; // get_best_move plays book moves
+
+    static bool open(const string &filename); // the previous book is released
+    static bool is_ready(); // a book open
+    static string opened_file();
+    static unsigned long long key(Position &pos);
+    // the legal book moves of the position with their weights
+    static vector<pair<Move, int>> moves(Position &pos);
+    // a book move picked at random by weight, false if the position is not in the book
+    static bool pick(Position &pos, Move &move);
+};
+
+#endif //CHESS_POLYGLOTBOOK_H
@@ -1,7 +1,17 @@
 #include "Position.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Trace.h"
+#include "PerftCheckpoint.h"
+#include "EvalCache.h"
+#include "Tablebase.h"
+#include "Syzygy.h"
+#include "PolyglotBook.h"
 #include <omp.h>
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
 #include <cmath>
 #include <algorithm>
 #include <bitset>
@@ -10,54 +20,361 @@
 using namespace std;
 
 Position::Position(string fen) {
-    string space_delimiter = " ";
-    vector<string> words{};
-    size_t pos = 0;
-    while ((pos = fen.find(space_delimiter)) != string::npos) {
-        words.push_back(fen.substr(0, pos));
-        fen.erase(0, pos + space_delimiter.length());
-    }
-    words.push_back(fen);
-    int j;
-    int column = 0;
-    int row = 7;
-    memset(this->chessboard, 0, sizeof(this->chessboard));
-    for (char c : words[0]) {
-        if (c == '/') {
-            row--;
-            column = 0;
-        } else {
-            if (isdigit(c)) {
+    ALLOC_SITE(AllocTracker::Fen_Parsing);
+    if (!set_fen(fen.data(), fen.size())) set_fen(Start_FEN.data(), Start_FEN.size());
+}
+
+// figure code by FEN letter, 0 for anything else
+static const struct Fen_Letter_Tables {
+    int codes[128];
+    char letters[24];
+    Fen_Letter_Tables() : codes(), letters() {
+        const char *names = "PNBRQKpnbrqk";
+        const int types[6] = { Pawn, Knight, Bishop, Rook, Queen, King };
+        for (int i = 0; i < 12; ++i) {
+            int code = (i < 6 ? White : Black) | types[i % 6];
+            codes[(int) names[i]] = code;
+            letters[code] = names[i];
+        }
+    }
+} Fen_Letters;
+
+// reads an unsigned decimal number of at most 9 digits, false if there is none
+static inline bool read_counter(const char *&cursor, const char *end, int &value) {
+    const char *start = cursor;
+    value = 0;
+    while (cursor < end && *cursor >= '0' && *cursor <= '9' && cursor - start < 9) value = value * 10 + (*cursor++ - '0');
+    return cursor > start && (cursor == end || *cursor == ' ');
+}
+
+static inline void skip_spaces(const char *&cursor, const char *end) {
+    while (cursor < end && *cursor == ' ') cursor++;
+}
+
+bool Position::set_fen(const char *fen, size_t length) {
+    const char *cursor = fen;
+    const char *end = fen + length;
+    skip_spaces(cursor, end);
+    // placement, from the 8th row down
+    Board_Setup setup;
+    for (int row = 7; row >= 0; --row) {
+        int column = 0;
+        while (cursor < end && column < 8) {
+            char c = *cursor;
+            if (c >= '1' && c <= '8') {
                 column += c - '0';
             } else {
-                j = Position::Get_Index_By_Row_And_Column(row, column);
-                chessboard[j] = Char_To_Number.at(c);
-                if (c == 'k') this->black_king_index = j;
-                else if (c == 'K') this->white_king_index = j;
+                int code = (c & 0x80) ? 0 : Fen_Letters.codes[(int) c];
+                if (code == 0) return false;
+                setup.place(code, row * 8 + column);
                 column++;
             }
+            cursor++;
+        }
+        if (column != 8) return false;
+        if (row > 0 && (cursor == end || *cursor++ != '/')) return false;
+    }
+    // side to move
+    if (cursor == end || *cursor++ != ' ') return false;
+    skip_spaces(cursor, end);
+    if (cursor == end || (*cursor != 'w' && *cursor != 'b')) return false;
+    bool white = *cursor++ == 'w';
+    // castling rights
+    if (cursor == end || *cursor++ != ' ') return false;
+    skip_spaces(cursor, end);
+    int rights = 0;
+    if (cursor < end && *cursor == '-') {
+        cursor++;
+    } else {
+        const char *names = "KQkq";
+        while (cursor < end && *cursor != ' ') {
+            const char *name = (const char *) memchr(names, *cursor++, 4);
+            if (name == nullptr || (rights & (1 << (name - names)))) return false;
+            rights |= 1 << (name - names);
+        }
+        if (rights == 0) return false;
+    }
+    // en passant square
+    if (cursor == end || *cursor++ != ' ') return false;
+    skip_spaces(cursor, end);
+    int en_passant = 128;
+    if (cursor < end && *cursor == '-') {
+        cursor++;
+    } else {
+        if (end - cursor < 2 || cursor[0] < 'a' || cursor[0] > 'h' || cursor[1] < '1' || cursor[1] > '8') return false;
+        en_passant = (cursor[1] - '1') * 8 + (cursor[0] - 'a');
+        cursor += 2;
+    }
+    // halfmove clock and fullmove number are optional
+    int halfmove = 0;
+    int fullmove = 1;
+    skip_spaces(cursor, end);
+    if (cursor < end && !read_counter(cursor, end, halfmove)) return false;
+    skip_spaces(cursor, end);
+    if (cursor < end && !read_counter(cursor, end, fullmove)) return false;
+    skip_spaces(cursor, end);
+    if (cursor != end) return false;
+    return set_board(setup, white, rights, en_passant, halfmove, fullmove);
+}
+
+bool Position::set_board(const Board_Setup &setup, bool white, int castling_rights, int en_passant, int halfmove,
+                         int fullmove) {
+    const int *board = setup.board;
+    if (!setup.valid || setup.kings[0] == -1 || setup.kings[1] == -1) return false;
+    // a castling right needs the king and that rook on their start squares, an en passant square the pawn that has
+    // just passed over it
+    static const int Rook_Squares[4] = { RW_Rook_Start_Index, LW_Rook_Start_Index, RB_Rook_Start_Index,
+                                         LB_Rook_Start_Index };
+    for (int i = 0; i < 4; ++i) {
+        int colour = i < 2 ? White : Black;
+        if ((castling_rights & (1 << i)) && (board[i < 2 ? W_King_Start_Index : B_King_Start_Index] != (colour | King) ||
+                                             board[Rook_Squares[i]] != (colour | Rook))) return false;
+    }
+    if (en_passant != 128 && ((en_passant >> 3) != (white ? 5 : 2) ||
+                              board[en_passant + (white ? -8 : 8)] != ((white ? Black : White) | Pawn) ||
+                              board[en_passant] != 0 || board[en_passant + (white ? 8 : -8)] != 0)) return false;
+    if (halfmove < 0 || halfmove > Max_Halfmove_Clock) return false;
+
+    memcpy(chessboard, board, sizeof(chessboard));
+    white_king_index = setup.kings[0];
+    black_king_index = setup.kings[1];
+    white_move = white;
+    enemy_king_index = white_move ? black_king_index : white_king_index;
+    white_can_castle_k = castling_rights & 1;
+    white_can_castle_q = castling_rights & 2;
+    black_can_castle_k = castling_rights & 4;
+    black_can_castle_q = castling_rights & 8;
+    possible_en_passant = en_passant;
+    halfmove_clock = halfmove;
+    fullmove_number = fullmove;
+    nodes = 0;
+    hash = setup.piece_key ^ Zobrist::Castling[castling_rights] ^ Zobrist::Get_En_Passant_Key(possible_en_passant) ^
+           (white_move ? 0 : Zobrist::Black_To_Move);
+    pawn_hash = setup.pawn_key;
+    material_pst = setup.score;
+    phase = setup.weight;
+    if (Nnue::Enabled) refresh_accumulator();
+    return true;
+}
+
+size_t Position::write_fen(char *buffer) {
+    char *out = buffer;
+    for (int row = 7; row >= 0; --row) {
+        int empty = 0;
+        for (int column = 0; column < 8; ++column) {
+            int figure = chessboard[row * 8 + column];
+            if (figure == 0) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) *out++ = (char) ('0' + empty);
+            empty = 0;
+            *out++ = Fen_Letters.letters[figure];
+        }
+        if (empty > 0) *out++ = (char) ('0' + empty);
+        if (row > 0) *out++ = '/';
+    }
+    *out++ = ' ';
+    *out++ = white_move ? 'w' : 'b';
+    *out++ = ' ';
+    if (get_castling_rights() == 0) *out++ = '-';
+    if (white_can_castle_k) *out++ = 'K';
+    if (white_can_castle_q) *out++ = 'Q';
+    if (black_can_castle_k) *out++ = 'k';
+    if (black_can_castle_q) *out++ = 'q';
+    *out++ = ' ';
+    if (possible_en_passant >= 0 && possible_en_passant < 64) {
+        *out++ = (char) ('a' + (possible_en_passant & 7));
+        *out++ = (char) ('1' + (possible_en_passant >> 3));
+    } else {
+        *out++ = '-';
+    }
+    for (int counter : { halfmove_clock, fullmove_number }) {
+        *out++ = ' ';
+        char digits[10];
+        int count = 0;
+        unsigned int value = (unsigned int) max(counter, 0);
+        do {
+            digits[count++] = (char) ('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) *out++ = digits[--count];
+    }
+    *out = '\0';
+    return (size_t) (out - buffer);
+}
+
+string Position::to_fen() {
+    char buffer[Max_Fen_Length];
+    return string(buffer, write_fen(buffer));
+}
+
+// promotion type of Move by letter (Q N B R), -1 for anything else
+static inline int promotion_type(char letter) {
+    switch (letter) {
+        case 'Q': case 'q': return 0;
+        case 'N': case 'n': return 1;
+        case 'B': case 'b': return 2;
+        case 'R': case 'r': return 3;
+        default: return -1;
+    }
+}
+
+// the legal moves of the side to move's figures of one type to a square
+static vector<Move> moves_to(Position &pos, int figure_type, int to) {
+    vector<Move> moves;
+    int figure = (pos.white_move ? White : Black) | figure_type;
+    for (int i = 0; i < 64; ++i) {
+        if (pos.chessboard[i] != figure) continue;
+        for (Move &move : pos.get_pseudolegal_moves(i)) {
+            if (move.to == to) moves.push_back(move);
         }
     }
-    this->white_move = words[1] == "w";
-    white_move ? enemy_king_index = black_king_index : enemy_king_index = white_king_index;
-    this->white_can_castle_k = words[2].find('K') != std::string::npos;
-    this->white_can_castle_q = words[2].find('Q') != std::string::npos;
-    this->black_can_castle_k = words[2].find('k') != std::string::npos;
-    this->black_can_castle_q = words[2].find('q') != std::string::npos;
-    if (words[3][0] != '-' && words[3][0] != ' '){
-        this->possible_en_passant = Position::Get_Index_By_Square(words[3]);
+    pos.filter_legal_moves(moves);
+    return moves;
+}
+
+bool Position::parse_san(const char *san, size_t length, Move &move) {
+    // check marks and annotations are not needed to find the move
+    while (length > 0 && (san[length - 1] == '+' || san[length - 1] == '#' || san[length - 1] == '!' ||
+                          san[length - 1] == '?')) length--;
+    if (length < 2) return false;
+    int king = white_move ? white_king_index : black_king_index;
+    int figure_type = Pawn;
+    int to = -1;
+    int from_column = -1;
+    int from_row = -1;
+    int promotion = -1;
+    bool castling = false;
+    if ((length == 3 || length == 5) && (san[0] == 'O' || san[0] == '0') && san[1] == '-' && san[2] == san[0] &&
+        (length == 3 || (san[3] == '-' && san[4] == san[0]))) {
+        castling = true;
+        figure_type = King;
+        to = length == 3 ? king + 2 : king - 2;
+    } else {
+        const char *cursor = san;
+        const char *end = san + length;
+        if (*cursor == 'K' || *cursor == 'Q' || *cursor == 'R' || *cursor == 'B' || *cursor == 'N') {
+            figure_type = Get_Type(Fen_Letters.codes[(int) *cursor++]);
+        }
+        // promotion at the end, with or without '='
+        if (figure_type == Pawn && end - cursor >= 3 && promotion_type(end[-1]) >= 0 &&
+            (end[-2] == '=' || (end[-2] >= '1' && end[-2] <= '8'))) {
+            promotion = promotion_type(end[-1]);
+            end -= end[-2] == '=' ? 2 : 1;
+        }
+        if (end - cursor < 2 || end[-2] < 'a' || end[-2] > 'h' || end[-1] < '1' || end[-1] > '8') return false;
+        to = (end[-1] - '1') * 8 + end[-2] - 'a';
+        end -= 2;
+        if (cursor < end && end[-1] == 'x') end--;
+        if (cursor < end && *cursor >= 'a' && *cursor <= 'h') from_column = *cursor++ - 'a';
+        if (cursor < end && *cursor >= '1' && *cursor <= '8') from_row = *cursor++ - '1';
+        if (cursor != end) return false;
+    }
+    int found = 0;
+    for (Move &candidate : moves_to(*this, figure_type, to)) {
+        if (castling && candidate.from != king) continue;
+        if (from_column >= 0 && (candidate.from & 7) != from_column) continue;
+        if (from_row >= 0 && (candidate.from >> 3) != from_row) continue;
+        // a promotion without a letter is taken as a queen
+        bool promotes = figure_type == Pawn && (to < 8 || to >= 56);
+        if (promotes ? candidate.get_promotion_type() != max(promotion, 0) : promotion >= 0) continue;
+        move = candidate;
+        found++;
     }
-    this->halfmove_clock = 0;
-    this->fullmove_number = 0;
-    if (words.size() > 4) {
-        if (words[4] != " " && words[4][0] != '-') this->halfmove_clock = words[4][0] - '0';
-        if (words.size() > 5 && words[5][0] != '-' && !isspace(words[5][0])) this->fullmove_number = words[5][0] - '0';
+    return found == 1;
+}
+
+size_t Position::write_san(Move move, char *buffer) {
+    char *out = buffer;
+    int figure_type = Get_Type(chessboard[move.from]);
+    if (figure_type == King && (move.to - move.from == 2 || move.to - move.from == -2)) {
+        const char *castling = move.to > move.from ? "O-O" : "O-O-O";
+        while (*castling != '\0') *out++ = *castling++;
+    } else {
+        bool capture = chessboard[move.to] != 0 || (figure_type == Pawn && (move.to & 7) != (move.from & 7));
+        if (figure_type == Pawn) {
+            if (capture) *out++ = (char) ('a' + (move.from & 7));
+        } else {
+            *out++ = Fen_Letters.letters[White | figure_type];
+            // the file if it tells the figures apart, else the row if it does, else both
+            bool ambiguous = false;
+            bool same_column = false;
+            bool same_row = false;
+            for (Move &other : moves_to(*this, figure_type, move.to)) {
+                if (other.from == move.from) continue;
+                ambiguous = true;
+                same_column = same_column || (other.from & 7) == (move.from & 7);
+                same_row = same_row || (other.from >> 3) == (move.from >> 3);
+            }
+            if (ambiguous && (!same_column || same_row)) *out++ = (char) ('a' + (move.from & 7));
+            if (ambiguous && same_column) *out++ = (char) ('1' + (move.from >> 3));
+        }
+        if (capture) *out++ = 'x';
+        *out++ = (char) ('a' + (move.to & 7));
+        *out++ = (char) ('1' + (move.to >> 3));
+        if (figure_type == Pawn && (move.to < 8 || move.to >= 56)) {
+            *out++ = '=';
+            *out++ = "QNBR"[move.get_promotion_type()];
+        }
     }
-    if (halfmove_clock < 0 || halfmove_clock > 50) halfmove_clock = 0;
+    make_move(move);
+    int checker_squares[18];
+    if (get_checkers(checker_squares) > 0) *out++ = count_legal_moves() == 0 ? '#' : '+';
+    undo_move(move);
+    *out = '\0';
+    return (size_t) (out - buffer);
+}
+
+string Position::to_san(Move move) {
+    char buffer[Max_San_Length];
+    return string(buffer, write_san(move, buffer));
 }
 
 const string Position::Start_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
+PerftTable Position::Perft_Table;
+
+bool Position::Activity_Terms = true;
+
+int Position::Square_Values[24][64];
+
+static bool init_square_values() {
+    for (int figure = 0; figure < 24; ++figure) {
+        bool real = Number_To_Char.count(figure) != 0;
+        for (int i = 0; i < 64; ++i) Position::Square_Values[figure][i] = real ? Make_Score(Get_Figure_Value(figure, i),
+                                                                                    Get_Figure_End_Value(figure, i)) : 0;
+    }
+    return true;
+}
+
+// filled before main(), no Position is evaluated during static initialisation
+static const bool square_values_initialized = init_square_values();
+
+// attack sets of knights and kings and the number of steps to the edge in every direction, by square
+static unsigned long long Knight_Attacks[64];
+static unsigned long long King_Attacks[64];
+static int Ray_Length[64][8];
+
+static bool init_attack_tables() {
+    for (int index = 0; index < 64; ++index) {
+        Knight_Attacks[index] = King_Attacks[index] = 0;
+        for (int offset : Knight_Offsets) {
+            if (Position::Is_No_Over_Edge_Move(index, index + offset)) Knight_Attacks[index] |= 1ULL << (index + offset);
+        }
+        for (int directionIndex = 0; directionIndex < 8; ++directionIndex) {
+            int offset = Direction_Offsets[directionIndex];
+            if (Position::Is_No_Over_Edge_Move(index, index + offset)) King_Attacks[index] |= 1ULL << (index + offset);
+            int length = 0;
+            for (int i = index + offset; Position::Is_No_Over_Edge_Move(i - offset, i); i += offset) length++;
+            Ray_Length[index][directionIndex] = length;
+        }
+    }
+    return true;
+}
+
+static const bool attack_tables_initialized = init_attack_tables();
+
 inline int Position::Get_Row_By_Index(int index) {
     return (index >> 3);
 }
@@ -75,6 +392,10 @@ inline int Position::Get_Index_By_Square(string square) {
     return Get_Index_By_Row_And_Column(square[1] - '1', square[0] - 'a');
 }
 
+string Position::Get_Square_By_Index(int index) {
+    return string(1, (char) ('a' + index % 8)) + (char) ('1' + index / 8);
+}
+
 bool Position::Are_On_Same_Line(int index1, int index2) {
     return ((Get_Row_By_Index(index1) == Get_Row_By_Index(index2) ||
              Get_Column_By_Index(index1) == Get_Column_By_Index(index2) ||
@@ -94,7 +415,193 @@ void Position::print_board() {
     cout << "" << endl;
 }
 
+int Position::get_castling_rights() {
+    return (white_can_castle_k) | (white_can_castle_q << 1) | (black_can_castle_k << 2) | (black_can_castle_q << 3);
+}
+
+unsigned long long Position::compute_hash() {
+    unsigned long long key = 0;
+    for (int i = 0; i < 64; ++i) key ^= Zobrist::Pieces[chessboard[i]][i];
+    key ^= Zobrist::Castling[get_castling_rights()];
+    key ^= Zobrist::Get_En_Passant_Key(possible_en_passant);
+    if (!white_move) key ^= Zobrist::Black_To_Move;
+    return key;
+}
+
+unsigned long long Position::compute_pawn_hash() {
+    unsigned long long key = 0;
+    for (int i = 0; i < 64; ++i) key ^= Zobrist::Pawns[chessboard[i]][i];
+    return key;
+}
+
+int Position::compute_material_pst() {
+    int value = 0;
+    for (int i = 0; i < 64; ++i) value += Square_Values[chessboard[i]][i];
+    return value;
+}
+
+int Position::compute_phase() {
+    int value = 0;
+    for (int i = 0; i < 64; ++i) value += Phase_Weights[Get_Type(chessboard[i])];
+    return value;
+}
+
+void Position::refresh_accumulator() {
+    Nnue::refresh(accumulator.allocate(), chessboard);
+}
+
+// sign = 1 right after make_move, -1 right before undo_move (the board shows the position after the move both times)
+void Position::update_accumulator(Move &move, int sign) {
+    if (!accumulator.allocated()) {
+        // set up or copied while the network was off: after a move the board is all it needs
+        refresh_accumulator();
+        if (sign > 0) return;
+    }
+    int16_t (*values)[Nnue::Hidden] = accumulator.get();
+    int figure = chessboard[move.to];
+    int moved = move.is_promotion() ? (Get_Colour(figure) | Pawn) : figure;
+    Nnue::update(values, moved, move.from, -sign);
+    Nnue::update(values, figure, move.to, sign);
+    if (move.does_capture()) {
+        int square = move.to;
+        if (move.is_en_passant()) square = Is_White(figure) ? move.to - 8 : move.to + 8;
+        Nnue::update(values, move.get_captured_figure(), square, -sign);
+    }
+    if (move.is_castling()) {
+        int rook = Get_Colour(figure) | Rook;
+        int rook_from = move.to > move.from ? move.to + 1 : move.to - 2;
+        int rook_to = move.to > move.from ? move.to - 1 : move.to + 1;
+        Nnue::update(values, rook, rook_from, -sign);
+        Nnue::update(values, rook, rook_to, sign);
+    }
+}
+
+// doubled, isolated and passed pawns from white's view, as a packed score
+int Position::evaluate_pawns() {
+    int counts[2][8] = {}; // pawns per file, white and black
+    int highest[2][8]; // row of the most advanced pawn seen from white's side, -1 if none
+    int lowest[2][8]; // 8 if none
+    for (int file = 0; file < 8; ++file) {
+        highest[0][file] = highest[1][file] = -1;
+        lowest[0][file] = lowest[1][file] = 8;
+    }
+    for (int i = 0; i < 64; ++i) {
+        if (Get_Type(chessboard[i]) != Pawn) continue;
+        int colour = Is_White(chessboard[i]) ? 0 : 1;
+        int file = Get_Column_By_Index(i);
+        counts[colour][file]++;
+        highest[colour][file] = max(highest[colour][file], Get_Row_By_Index(i));
+        lowest[colour][file] = min(lowest[colour][file], Get_Row_By_Index(i));
+    }
+    int middlegame = 0;
+    int endgame = 0;
+    for (int i = 0; i < 64; ++i) {
+        if (Get_Type(chessboard[i]) != Pawn) continue;
+        int colour = Is_White(chessboard[i]) ? 0 : 1;
+        int sign = colour == 0 ? 1 : -1;
+        int file = Get_Column_By_Index(i);
+        int row = Get_Row_By_Index(i);
+        if ((file == 0 || counts[colour][file - 1] == 0) && (file == 7 || counts[colour][file + 1] == 0)) {
+            middlegame += sign * Isolated_Pawn[0];
+            endgame += sign * Isolated_Pawn[1];
+        }
+        bool passed = true;
+        for (int f = max(file - 1, 0); f <= min(file + 1, 7); ++f) {
+            if (colour == 0 ? highest[1][f] > row : lowest[0][f] < row) passed = false;
+        }
+        if (passed) {
+            int advanced = colour == 0 ? row - 1 : 6 - row;
+            middlegame += sign * Passed_Pawn[0][advanced];
+            endgame += sign * Passed_Pawn[1][advanced];
+        }
+    }
+    for (int file = 0; file < 8; ++file) {
+        for (int colour = 0; colour < 2; ++colour) {
+            if (counts[colour][file] < 2) continue;
+            int sign = colour == 0 ? 1 : -1;
+            middlegame += sign * (counts[colour][file] - 1) * Doubled_Pawn[0];
+            endgame += sign * (counts[colour][file] - 1) * Doubled_Pawn[1];
+        }
+    }
+    return Make_Score(middlegame, endgame);
+}
+
+// squares the figure on index attacks (or defends), the same steps as get_pseudolegal_moves
+unsigned long long Position::get_attacks(int index) {
+    static const int Offsets[8] = {1, 8, -1, -8, 7, 9, -7, -9}; // Direction_Offsets
+    int figure = chessboard[index];
+    int figure_type = Get_Type(figure);
+    if (figure_type == Knight) return Knight_Attacks[index];
+    if (figure_type == King) return King_Attacks[index];
+    unsigned long long attacks = 0;
+    if (figure_type == Pawn) {
+        int column = Get_Column_By_Index(index);
+        int forward = Is_White(figure) ? 8 : -8;
+        if (column != 0) attacks |= 1ULL << (index + forward - 1);
+        if (column != 7) attacks |= 1ULL << (index + forward + 1);
+    } else if (Is_Sliding_Piece(figure)) {
+        int startIndex = (figure_type == Bishop) ? 4 : 0;
+        int endIndex = (figure_type == Rook) ? 4 : 8;
+        for (int directionIndex = startIndex; directionIndex < endIndex; ++directionIndex) {
+            int i = index;
+            for (int step = Ray_Length[index][directionIndex]; step > 0; --step) {
+                i += Offsets[directionIndex];
+                attacks |= 1ULL << i;
+                if (chessboard[i] != 0) break;
+            }
+        }
+    }
+    return attacks;
+}
+
+// mobility and king safety from white's view, as a packed score
+int Position::evaluate_activity() {
+    static const unsigned long long Not_A_File = 0xFEFEFEFEFEFEFEFEULL;
+    static const unsigned long long Not_H_File = 0x7F7F7F7F7F7F7F7FULL;
+    unsigned long long own[2] = {0, 0}; // squares of white's and black's figures
+    unsigned long long pawns[2] = {0, 0};
+    int pieces[32]; // knights, bishops, rooks and queens
+    int piece_count = 0;
+    for (int i = 0; i < 64; ++i) {
+        int figure_type = Get_Type(chessboard[i]);
+        if (figure_type == 0) continue;
+        int colour = Is_White(chessboard[i]) ? 0 : 1;
+        own[colour] |= 1ULL << i;
+        if (figure_type == Pawn) pawns[colour] |= 1ULL << i;
+        else if (figure_type != King && piece_count < 32) pieces[piece_count++] = i;
+    }
+    unsigned long long pawn_attacks[2] = {((pawns[0] << 7) & Not_H_File) | ((pawns[0] << 9) & Not_A_File),
+                                          ((pawns[1] >> 9) & Not_H_File) | ((pawns[1] >> 7) & Not_A_File)};
+    unsigned long long king_zone[2] = {King_Attacks[white_king_index] | 1ULL << white_king_index,
+                                       King_Attacks[black_king_index] | 1ULL << black_king_index};
+    int attackers[2] = {0, 0}; // on the zone around white's and black's king
+    int attack_weight[2] = {0, 0};
+    int middlegame = 0;
+    int endgame = 0;
+    for (int p = 0; p < piece_count; ++p) {
+        int i = pieces[p];
+        int figure_type = Get_Type(chessboard[i]);
+        int colour = Is_White(chessboard[i]) ? 0 : 1;
+        int sign = colour == 0 ? 1 : -1;
+        unsigned long long attacks = get_attacks(i);
+        int mobility = __builtin_popcountll(attacks & ~own[colour] & ~pawn_attacks[1 - colour]) -
+                       Mobility_Average[figure_type];
+        middlegame += sign * mobility * Mobility_Weight[0][figure_type];
+        endgame += sign * mobility * Mobility_Weight[1][figure_type];
+        if (attacks & king_zone[1 - colour]) {
+            attackers[1 - colour]++;
+            attack_weight[1 - colour] += King_Attack_Weight[figure_type];
+        }
+    }
+    for (int colour = 0; colour < 2; ++colour) {
+        int sign = colour == 0 ? 1 : -1;
+        middlegame -= sign * attack_weight[colour] * King_Attack_Scale[min(attackers[colour], 7)] / 10;
+    }
+    return Make_Score(middlegame, endgame);
+}
+
 Position Position::copy() {
+    ALLOC_SITE(AllocTracker::Position_Copy);
     Position pos = Position();
     std::copy(std::begin(chessboard), std::end(chessboard), std::begin(pos.chessboard));
     pos.white_move = white_move;
@@ -108,17 +615,24 @@ Position Position::copy() {
     pos.possible_en_passant = possible_en_passant;
     pos.halfmove_clock = halfmove_clock;
     pos.fullmove_number = fullmove_number;
+    pos.hash = hash;
+    pos.pawn_hash = pawn_hash;
+    pos.material_pst = material_pst;
+    pos.phase = phase;
+    pos.accumulator = accumulator;
     pos.best_move = best_move.copy();
     return pos;
 }
 
 vector<Move> Position::get_pseudolegal_moves(int index) {
+    ALLOC_SITE(AllocTracker::Pseudolegal_Moves);
     vector<Move> moves;
     if (chessboard[index] == 0) return moves;
     int figure = chessboard[index];
     int figure_type = Get_Type(figure);
     int row = Get_Row_By_Index(index);
     int column = Get_Column_By_Index(index);
+    PROFILE_SCOPE(Profiler::Gen_By_Type[figure_type]);
     if (figure_type == Pawn) {
         if (Is_White(figure)) { // White Pawn
             if (chessboard[index + 8] == 0) {
@@ -234,6 +748,7 @@ bool Position::Is_No_Over_Edge_Move(int index_from, int index_to) {
 }
 
 bool Position::is_no_figure_between(int index1, int index2, int a) {
+    PROFILE_SCOPE(Profiler::Is_No_Figure_Between);
     // check if there's a figure between, on a straight/diagonal line (specified by offset a, e.g. a=1 -> row
     if (index1 > index2) swap(index1, index2);
     // always check if line goes over edge!
@@ -252,13 +767,15 @@ bool Position::is_it_your_turn(int figure) {
 }
 
 void Position::make_move(Move &move) {
+    PROFILE_SCOPE(Profiler::Make_Move);
     int figure_type = Get_Type(chessboard[move.from]);
     int distance = move.to - move.from;
+    int castling_rights = get_castling_rights();
     // save irreversible info:
-    move.info |= (((white_can_castle_k) | (white_can_castle_q << 1) | (black_can_castle_k << 2) |
-                   (black_can_castle_q << 3)) << 8);
-    move.info |= halfmove_clock << 12;
+    move.info |= castling_rights << 8;
+    move.info |= (halfmove_clock & 63) << 12 | (halfmove_clock >> 6) << 28;
     move.info |= possible_en_passant << 18;
+    hash ^= Zobrist::Castling[castling_rights] ^ Zobrist::Get_En_Passant_Key(possible_en_passant);
     // check castling:
     if (white_move && (white_can_castle_k || white_can_castle_q)) {
         if ((move.from == W_King_Start_Index || move.from == LW_Rook_Start_Index) && white_can_castle_q) {
@@ -277,7 +794,15 @@ void Position::make_move(Move &move) {
         }
     }
     // make move:
-    move.info |= chessboard[move.to];
+    int captured = chessboard[move.to]; // not move.does_capture(): moves coming back from a make_move keep their info
+    move.info |= captured;
+    phase -= Phase_Weights[Get_Type(captured)];
+    hash ^= Zobrist::Pieces[chessboard[move.from]][move.from] ^ Zobrist::Pieces[chessboard[move.from]][move.to] ^
+            Zobrist::Pieces[captured][move.to];
+    pawn_hash ^= Zobrist::Pawns[chessboard[move.from]][move.from] ^ Zobrist::Pawns[chessboard[move.from]][move.to] ^
+                 Zobrist::Pawns[captured][move.to];
+    material_pst += Square_Values[chessboard[move.from]][move.to] - Square_Values[chessboard[move.from]][move.from] -
+                    Square_Values[captured][move.to];
     chessboard[move.to] = chessboard[move.from];
     chessboard[move.from] = 0;
     // promotion or en passant?
@@ -287,6 +812,9 @@ void Position::make_move(Move &move) {
             possible_en_passant = move.from + (distance / 2);
         } else if (Get_Row_By_Index(move.to) == 7 || Get_Row_By_Index(move.to) == 0) {
             // promotion:
+            hash ^= Zobrist::Pieces[chessboard[move.to]][move.to];
+            pawn_hash ^= Zobrist::Pawns[chessboard[move.to]][move.to];
+            material_pst -= Square_Values[chessboard[move.to]][move.to];
             //cout << "pt: " << move.get_ep_state() << endl;
             if (move.get_promotion_type() == 0){
                 //cout << "queen" << endl;
@@ -302,16 +830,26 @@ void Position::make_move(Move &move) {
                 //cout << "rook" << endl;
                 chessboard[move.to] += 4; // make the pawn a rook
             }
+            hash ^= Zobrist::Pieces[chessboard[move.to]][move.to];
+            pawn_hash ^= Zobrist::Pawns[chessboard[move.to]][move.to];
+            material_pst += Square_Values[chessboard[move.to]][move.to];
+            phase += Phase_Weights[Get_Type(chessboard[move.to])];
             move.info |= Move::promotion_mask;
-        } else if (distance % 8 != 0 && !move.does_capture()) {
+        } else if (distance % 8 != 0 && captured == 0) {
             // en passant:
             move.info |= Move::en_passant_mask;
             if (white_move) {
                 move.info |= (Black | Pawn);
                 chessboard[move.to - 8] = 0;
+                hash ^= Zobrist::Pieces[Black | Pawn][move.to - 8];
+                pawn_hash ^= Zobrist::Pawns[Black | Pawn][move.to - 8];
+                material_pst -= Square_Values[Black | Pawn][move.to - 8];
             } else {
                 move.info |= (White | Pawn);
                 chessboard[move.to + 8] = 0;
+                hash ^= Zobrist::Pieces[White | Pawn][move.to + 8];
+                pawn_hash ^= Zobrist::Pawns[White | Pawn][move.to + 8];
+                material_pst -= Square_Values[White | Pawn][move.to + 8];
             }
         }
     }
@@ -340,51 +878,88 @@ void Position::make_move(Move &move) {
             // castling short
             chessboard[move.to - 1] = chessboard[move.to + 1];
             chessboard[move.to + 1] = 0;
+            hash ^= Zobrist::Pieces[chessboard[move.to - 1]][move.to - 1] ^ Zobrist::Pieces[chessboard[move.to - 1]][move.to + 1];
+            material_pst += Square_Values[chessboard[move.to - 1]][move.to - 1] - Square_Values[chessboard[move.to - 1]][move.to + 1];
             move.info |= Move::castling_mask;
         } else if (distance == -2) {
             // castling long
             chessboard[move.to + 1] = chessboard[move.to - 2];
             chessboard[move.to - 2] = 0;
+            hash ^= Zobrist::Pieces[chessboard[move.to + 1]][move.to + 1] ^ Zobrist::Pieces[chessboard[move.to + 1]][move.to - 2];
+            material_pst += Square_Values[chessboard[move.to + 1]][move.to + 1] - Square_Values[chessboard[move.to + 1]][move.to - 2];
             move.info |= Move::castling_mask;
         }
     }
-    (move.does_capture() || figure_type == Pawn ) ? halfmove_clock = 0 : halfmove_clock++;
+    (move.does_capture() || figure_type == Pawn ) ? halfmove_clock = 0 : halfmove_clock = min(halfmove_clock + 1,
+                                                                                               Max_Halfmove_Clock);
+    hash ^= Zobrist::Castling[get_castling_rights()] ^ Zobrist::Get_En_Passant_Key(possible_en_passant) ^
+            Zobrist::Black_To_Move;
     if (!white_move){
         fullmove_number++;
         enemy_king_index = black_king_index;
     } else enemy_king_index = white_king_index;
     white_move = !white_move;
+    if (Nnue::Enabled) update_accumulator(move, 1);
 }
 
 void Position::undo_move(Move move) {
+    if (Nnue::Enabled) update_accumulator(move, -1);
     int figure_type = Get_Type(chessboard[move.to]);
     int distance = move.to - move.from;
     int castling_info = move.get_castling_rights();
+    hash ^= Zobrist::Castling[get_castling_rights()] ^ Zobrist::Get_En_Passant_Key(possible_en_passant) ^
+            Zobrist::Black_To_Move;
     white_can_castle_k = castling_info & 1;
     white_can_castle_q = castling_info & 2;
     black_can_castle_k = castling_info & 4;
     black_can_castle_q = castling_info & 8;
     halfmove_clock = move.get_halfmove_clock();
     possible_en_passant = move.get_ep_state();
+    hash ^= Zobrist::Castling[castling_info] ^ Zobrist::Get_En_Passant_Key(possible_en_passant);
     // undo move:
+    hash ^= Zobrist::Pieces[chessboard[move.to]][move.to] ^ Zobrist::Pieces[chessboard[move.to]][move.from];
+    pawn_hash ^= Zobrist::Pawns[chessboard[move.to]][move.to] ^ Zobrist::Pawns[chessboard[move.to]][move.from];
+    material_pst += Square_Values[chessboard[move.to]][move.from] - Square_Values[chessboard[move.to]][move.to];
     chessboard[move.from] = chessboard[move.to];
     chessboard[move.to] = move.get_captured_figure();
+    phase += Phase_Weights[Get_Type(chessboard[move.to])];
     // promotion or en passant or castling?
     if (move.is_promotion()) {
+        hash ^= Zobrist::Pieces[chessboard[move.from]][move.from];
+        pawn_hash ^= Zobrist::Pawns[chessboard[move.from]][move.from];
+        material_pst -= Square_Values[chessboard[move.from]][move.from];
+        phase -= Phase_Weights[Get_Type(chessboard[move.from])];
         white_move ? chessboard[move.from] = Black | Pawn : chessboard[move.from] = White | Pawn; // make it a pawn
+        hash ^= Zobrist::Pieces[chessboard[move.from]][move.from];
+        pawn_hash ^= Zobrist::Pawns[chessboard[move.from]][move.from];
+        hash ^= Zobrist::Pieces[chessboard[move.to]][move.to];
+        pawn_hash ^= Zobrist::Pawns[chessboard[move.to]][move.to];
+        material_pst += Square_Values[chessboard[move.from]][move.from] + Square_Values[chessboard[move.to]][move.to];
     } else if (move.is_en_passant()) {
         white_move ? chessboard[move.to + 8] = chessboard[move.to] : chessboard[move.to - 8] = chessboard[move.to];
+        hash ^= Zobrist::Pieces[chessboard[move.to]][white_move ? move.to + 8 : move.to - 8];
+        pawn_hash ^= Zobrist::Pawns[chessboard[move.to]][white_move ? move.to + 8 : move.to - 8];
+        material_pst += Square_Values[chessboard[move.to]][white_move ? move.to + 8 : move.to - 8];
         chessboard[move.to] = 0;
-    } else if (figure_type == King) {
+    } else {
+        hash ^= Zobrist::Pieces[chessboard[move.to]][move.to];
+        pawn_hash ^= Zobrist::Pawns[chessboard[move.to]][move.to];
+        material_pst += Square_Values[chessboard[move.to]][move.to];
+    }
+    if (figure_type == King) {
         white_move ? black_king_index = move.from : white_king_index = move.from;
         if (distance == 2) {
             // castling short
             chessboard[move.to + 1] = chessboard[move.to - 1];
             chessboard[move.to - 1] = 0;
+            hash ^= Zobrist::Pieces[chessboard[move.to + 1]][move.to + 1] ^ Zobrist::Pieces[chessboard[move.to + 1]][move.to - 1];
+            material_pst += Square_Values[chessboard[move.to + 1]][move.to + 1] - Square_Values[chessboard[move.to + 1]][move.to - 1];
         } else if (distance == -2) {
             // castling long
             chessboard[move.to - 2] = chessboard[move.to + 1];
             chessboard[move.to + 1] = 0;
+            hash ^= Zobrist::Pieces[chessboard[move.to - 2]][move.to - 2] ^ Zobrist::Pieces[chessboard[move.to - 2]][move.to + 1];
+            material_pst += Square_Values[chessboard[move.to - 2]][move.to - 2] - Square_Values[chessboard[move.to - 2]][move.to + 1];
         }
     }
     if (white_move){
@@ -395,6 +970,7 @@ void Position::undo_move(Move move) {
 }
 
 vector<Move> Position::get_all_pseudolegal_moves() {
+    ALLOC_SITE(AllocTracker::All_Pseudolegal_Moves);
     vector<Move> all_moves;
     for (int i = 0; i < 64; ++i) {
         if (is_it_your_turn(chessboard[i])) {
@@ -406,6 +982,7 @@ vector<Move> Position::get_all_pseudolegal_moves() {
 }
 
 bool Position::is_hanging(int index) {
+    PROFILE_SCOPE(Profiler::Is_Hanging);
     int row = Get_Row_By_Index(index);
     int column = Get_Column_By_Index(index);
     int row_i;
@@ -499,6 +1076,7 @@ bool Position::is_threatened_by_pawn(int index) {
 }
 
 vector<Move> Position::get_all_legal_moves() {
+    ALLOC_SITE(AllocTracker::Legal_Moves);
     vector<Move> moves = get_all_pseudolegal_moves();
     vector<Move> legal_moves;
     for (Move move : moves) {
@@ -509,35 +1087,145 @@ vector<Move> Position::get_all_legal_moves() {
     return legal_moves;
 }
 
+bool Position::is_king_move_safe(int from, int to) {
+    // the king must be off the board, or it would block a slider's ray through 'from'; the captured figure
+    // (if any) must be off as well, or it would count as attacking its own square
+    int king = chessboard[from];
+    int captured = chessboard[to];
+    chessboard[from] = 0;
+    chessboard[to] = 0;
+    bool safe = !is_threatened(to);
+    chessboard[from] = king;
+    chessboard[to] = captured;
+    return safe;
+}
+
+void Position::filter_legal_moves(vector<Move> &moves) {
+    // Decides legality from the pins and checks against the own king instead of making every move.
+    int king_index = white_move ? white_king_index : black_king_index;
+    int own_colour = white_move ? White : Black;
+    unsigned long long check_mask = ~0ULL; // squares that capture the checker or block the check
+    int checkers = 0;
+    int pinned_squares[8];
+    unsigned long long pin_lines[8];
+    int pin_count = 0;
+    for (int direction_index = 0; direction_index < 8; ++direction_index) {
+        int offset = Direction_Offsets[direction_index];
+        bool diagonal = direction_index >= 4;
+        unsigned long long line = 0;
+        int own_piece = -1;
+        for (int i = king_index + offset; Is_No_Over_Edge_Move(i - offset, i); i += offset) {
+            line |= 1ULL << i;
+            int figure = chessboard[i];
+            if (figure == 0) continue;
+            if (Is_Colour(figure, own_colour)) {
+                if (own_piece != -1) break; // two own pieces: no pin
+                own_piece = i;
+                continue;
+            }
+            int type = Get_Type(figure);
+            bool slider = (type == Queen) || (diagonal ? type == Bishop : type == Rook);
+            if (slider) {
+                if (own_piece == -1) {
+                    checkers++;
+                    check_mask &= line;
+                } else {
+                    pinned_squares[pin_count] = own_piece;
+                    pin_lines[pin_count++] = line;
+                }
+            }
+            break;
+        }
+    }
+    int column = Get_Column_By_Index(king_index);
+    int enemy_knight = (white_move ? Black : White) | Knight;
+    for (int offset : Knight_Offsets) {
+        int i = king_index + offset;
+        if (Is_No_Over_Edge_Move(king_index, i) && chessboard[i] == enemy_knight) {
+            checkers++;
+            check_mask &= 1ULL << i;
+        }
+    }
+    int enemy_pawn = (white_move ? Black : White) | Pawn;
+    int pawn_left = white_move ? king_index + 7 : king_index - 9;
+    int pawn_right = white_move ? king_index + 9 : king_index - 7;
+    if (column != 0 && pawn_left >= 0 && pawn_left < 64 && chessboard[pawn_left] == enemy_pawn) {
+        checkers++;
+        check_mask &= 1ULL << pawn_left;
+    }
+    if (column != 7 && pawn_right >= 0 && pawn_right < 64 && chessboard[pawn_right] == enemy_pawn) {
+        checkers++;
+        check_mask &= 1ULL << pawn_right;
+    }
+    size_t legal = 0;
+    for (size_t m = 0; m < moves.size(); ++m) {
+        Move &move = moves[m];
+        bool is_legal;
+        int figure_type = Get_Type(chessboard[move.from]);
+        if (move.from == king_index) {
+            is_legal = is_king_move_safe(move.from, move.to);
+        } else if (figure_type == Pawn && (move.to - move.from) % 8 != 0 && chessboard[move.to] == 0) {
+            // en passant removes two pieces from the king's lines, let make_move sort it out
+            Move copy = move;
+            make_move(copy);
+            is_legal = !is_hanging(enemy_king_index);
+            undo_move(copy);
+        } else if (checkers > 1) {
+            is_legal = false;
+        } else {
+            is_legal = (check_mask >> move.to) & 1;
+            for (int p = 0; is_legal && p < pin_count; ++p) {
+                if (pinned_squares[p] == move.from) is_legal = (pin_lines[p] >> move.to) & 1;
+            }
+        }
+        if (is_legal) moves[legal++] = move;
+    }
+    moves.resize(legal);
+}
+
+int Position::count_legal_moves() {
+    vector<Move> moves = get_all_pseudolegal_moves();
+    filter_legal_moves(moves);
+    return (int) moves.size();
+}
+
 long long int Position::perft(int depth) {
+    PROFILE_COUNT(Profiler::Perft_Node);
+    ALLOC_SITE(AllocTracker::Perft);
     if (depth == 0) {
         if (is_hanging(enemy_king_index)){
             return 0;
         }
         return 1;
     }
+    long long int num_pos = 0;
+    if (Perft_Table.probe(hash, depth, num_pos)) return num_pos;
     vector<Move> moves = get_all_pseudolegal_moves();
     for (Move move : moves) {
         if (move.to == enemy_king_index) {
             return 0;
         }
     }
-    long long int num_pos = 0;
     for (Move move : moves) {
         make_move(move);
         num_pos += perft(depth - 1);
         undo_move(move);
     }
+    Perft_Table.store(hash, depth, num_pos);
     return num_pos;
 }
 
 long long int Position::perft_parallel(int depth) {
+    ALLOC_SITE(AllocTracker::Perft_Parallel);
+    if (depth <= 0) return 1;
     vector<Move> legal_moves = get_all_legal_moves();
     long long int perft_result = 0;
 #pragma omp parallel num_threads(omp_get_max_threads())
     {
+        PerfCounters::Thread_Scope perf_scope;
 #pragma omp for schedule(dynamic, 1) reduction(+ : perft_result)
         for (Move move : legal_moves) {
+            Trace::Span span("root move", move);
             Position p = copy();
             p.make_move(move);
             perft_result += p.perft(depth - 1);
@@ -546,6 +1234,156 @@ long long int Position::perft_parallel(int depth) {
     return perft_result;
 }
 
+long long int Position::perft_bulk(int depth) {
+    // counts the same positions as perft, but only follows legal moves and counts the last ply without making it
+    PROFILE_COUNT(Profiler::Perft_Node);
+    ALLOC_SITE(AllocTracker::Perft);
+    if (depth == 0) return 1;
+    if (depth == 1) return count_legal_moves();
+    long long int num_pos = 0;
+    if (Perft_Table.probe(hash, depth, num_pos)) return num_pos;
+    vector<Move> moves = get_all_pseudolegal_moves();
+    filter_legal_moves(moves);
+    for (Move move : moves) {
+        make_move(move);
+        num_pos += perft_bulk(depth - 1);
+        undo_move(move);
+    }
+    Perft_Table.store(hash, depth, num_pos);
+    return num_pos;
+}
+
+long long int Position::perft_bulk_parallel(int depth) {
+    ALLOC_SITE(AllocTracker::Perft_Parallel);
+    if (depth <= 0) return 1;
+    vector<Move> legal_moves = get_all_pseudolegal_moves();
+    filter_legal_moves(legal_moves);
+    long long int perft_result = 0;
+#pragma omp parallel num_threads(omp_get_max_threads())
+    {
+        PerfCounters::Thread_Scope perf_scope;
+#pragma omp for schedule(dynamic, 1) reduction(+ : perft_result)
+        for (Move move : legal_moves) {
+            Trace::Span span("root move", move);
+            Position p = copy();
+            p.make_move(move);
+            perft_result += p.perft_bulk(depth - 1);
+        }
+    }
+    return perft_result;
+}
+
+void Perft_Stats::add(const Perft_Stats &other) {
+    nodes += other.nodes;
+    captures += other.captures;
+    en_passants += other.en_passants;
+    castles += other.castles;
+    promotions += other.promotions;
+    checks += other.checks;
+    discovered_checks += other.discovered_checks;
+    double_checks += other.double_checks;
+    checkmates += other.checkmates;
+}
+
+int Position::get_checkers(int checker_squares[]) {
+    // enemy figures attacking the king of the side to move (at most 2 in a legal position, but room for 18)
+    int king_index = white_move ? white_king_index : black_king_index;
+    int enemy_colour = white_move ? Black : White;
+    int checkers = 0;
+    for (int direction_index = 0; direction_index < 8; ++direction_index) {
+        int offset = Direction_Offsets[direction_index];
+        for (int i = king_index + offset; Is_No_Over_Edge_Move(i - offset, i); i += offset) {
+            int figure = chessboard[i];
+            if (figure == 0) continue;
+            int type = Get_Type(figure);
+            if (Is_Colour(figure, enemy_colour) &&
+                (type == Queen || (direction_index >= 4 ? type == Bishop : type == Rook))) {
+                checker_squares[checkers++] = i;
+            }
+            break;
+        }
+    }
+    for (int offset : Knight_Offsets) {
+        int i = king_index + offset;
+        if (Is_No_Over_Edge_Move(king_index, i) && chessboard[i] == (enemy_colour | Knight)) checker_squares[checkers++] = i;
+    }
+    int column = Get_Column_By_Index(king_index);
+    int pawn_left = white_move ? king_index + 7 : king_index - 9;
+    int pawn_right = white_move ? king_index + 9 : king_index - 7;
+    if (column != 0 && pawn_left >= 0 && pawn_left < 64 && chessboard[pawn_left] == (enemy_colour | Pawn)) {
+        checker_squares[checkers++] = pawn_left;
+    }
+    if (column != 7 && pawn_right >= 0 && pawn_right < 64 && chessboard[pawn_right] == (enemy_colour | Pawn)) {
+        checker_squares[checkers++] = pawn_right;
+    }
+    return checkers;
+}
+
+void Position::perft_stats(int depth, Perft_Stats &stats) {
+    if (depth == 0) {
+        stats.nodes++;
+        return;
+    }
+    vector<Move> moves = get_all_pseudolegal_moves();
+    filter_legal_moves(moves);
+    for (Move move : moves) {
+        make_move(move);
+        if (depth == 1) {
+            stats.nodes++;
+            if (move.does_capture()) stats.captures++;
+            if (move.is_en_passant()) stats.en_passants++;
+            if (move.is_castling()) stats.castles++;
+            if (move.is_promotion()) stats.promotions++;
+            int checker_squares[18];
+            int checkers = get_checkers(checker_squares);
+            if (checkers > 0) {
+                stats.checks++;
+                // a check is discovered if the figure that just moved (for castling: the rook) is not a checker
+                int moved_square = move.to;
+                if (move.is_castling()) moved_square = (move.to > move.from) ? move.to - 1 : move.to + 1;
+                bool discovered = true;
+                for (int i = 0; i < checkers; ++i) if (checker_squares[i] == moved_square) discovered = false;
+                if (discovered) stats.discovered_checks++;
+                if (checkers > 1) stats.double_checks++;
+                if (count_legal_moves() == 0) stats.checkmates++;
+            }
+        } else {
+            perft_stats(depth - 1, stats);
+        }
+        undo_move(move);
+    }
+}
+
+Perft_Stats Position::perft_stats_parallel(int depth) {
+    Perft_Stats total;
+    if (depth <= 0) {
+        total.nodes = 1;
+        return total;
+    }
+    if (depth == 1) {
+        perft_stats(depth, total);
+        return total;
+    }
+    vector<Move> legal_moves = get_all_pseudolegal_moves();
+    filter_legal_moves(legal_moves);
+#pragma omp parallel num_threads(omp_get_max_threads())
+    {
+        PerfCounters::Thread_Scope perf_scope;
+        Perft_Stats local; // per thread, merged once at the end
+#pragma omp for schedule(dynamic, 1)
+        for (size_t i = 0; i < legal_moves.size(); ++i) {
+            Trace::Span span("root move", legal_moves[i]);
+            Position p = copy();
+            Move move = legal_moves[i];
+            p.make_move(move);
+            p.perft_stats(depth - 1, local);
+        }
+#pragma omp critical
+        total.add(local);
+    }
+    return total;
+}
+
 long long int Position::perft_divide(int depth, int max_depth) {
     if (depth == 0) return 1;
     vector<Move> moves = get_all_legal_moves();
@@ -560,16 +1398,26 @@ long long int Position::perft_divide(int depth, int max_depth) {
     return num_pos;
 }
 
-long long int Position::perft_divide_parallel(int depth) {
+long long int Position::perft_divide_parallel(int depth, const string &checkpoint_file) {
+    if (depth <= 0) return 1;
     vector<Move> legal_moves = get_all_legal_moves();
+    vector<string> move_names;
+    for (Move move : legal_moves) move_names.push_back(move.to_letter_string());
+    PerftCheckpoint checkpoint(checkpoint_file, hash, depth, move_names);
     long long int perft_result = 0;
 #pragma omp parallel num_threads(omp_get_max_threads())
     {
+        PerfCounters::Thread_Scope perf_scope;
 #pragma omp for schedule(dynamic, 1) reduction(+ : perft_result)
         for (Move move : legal_moves) {
-            Position p = copy();
-            p.make_move(move);
-            int num_pos = p.perft(depth - 1);
+            long long int num_pos;
+            if (!checkpoint.find(move.to_letter_string(), num_pos)) {
+                Trace::Span span("root move", move);
+                Position p = copy();
+                p.make_move(move);
+                num_pos = p.perft(depth - 1);
+                checkpoint.record(move.to_letter_string(), num_pos);
+            }
             cout << "making move: " << move.to_letter_string() << "\t | number of positions: " << num_pos << endl;
             perft_result += num_pos;
         }
@@ -590,31 +1438,123 @@ long long int Position::other_perft(int depth) {
     return num_pos;
 }
 
-int Position::evaluate() {
-    int value = 0;
-    for (int i = 0; i < 64; i++) {
-        if (chessboard[i] != 0) value += Get_Figure_Value(chessboard[i], i);
+int Position::evaluate(int alpha, int beta) {
+    PROFILE_SCOPE(Profiler::Evaluate);
+#ifdef CHESS_CHECK_EVAL
+    if (material_pst != compute_material_pst() || phase != compute_phase() || pawn_hash != compute_pawn_hash()) {
+        cerr << "incremental material/pst " << material_pst << " phase " << phase << " pawn key " << pawn_hash <<
+             " != recomputed " << compute_material_pst() << " phase " << compute_phase() << " pawn key " <<
+             compute_pawn_hash() << endl;
+        abort();
+    }
+    if (Nnue::Enabled && accumulator.allocated()) {
+        int16_t refreshed[2][Nnue::Hidden];
+        Nnue::refresh(refreshed, chessboard);
+        if (memcmp(refreshed, accumulator.get(), sizeof(refreshed)) != 0) {
+            cerr << "incremental network accumulator differs from a refresh" << endl;
+            abort();
+        }
+    }
+#endif
+    EvalCache::Tables *tables = EvalCache::Enabled ? &EvalCache::thread_tables() : nullptr;
+    // the network and the classical evaluation give different values, so they use different keys
+    unsigned long long key = Nnue::Enabled ? ~hash : hash;
+    EvalCache::Eval_Entry *cached = nullptr;
+    if (tables != nullptr) {
+        tables->eval_probes++;
+        cached = &tables->evals[key & (EvalCache::Eval_Entries - 1)];
+        if (cached->key == key && (!cached->lazy || cached->value + Lazy_Margin <= alpha ||
+                                   cached->value - Lazy_Margin >= beta)) {
+            tables->eval_hits++;
+            return cached->value;
+        }
+    }
+    int value;
+    if (Nnue::Enabled) {
+        if (!accumulator.allocated()) refresh_accumulator();
+        value = Nnue::evaluate(accumulator.get(), white_move);
+    } else {
+        int pawn_score;
+        if (tables != nullptr) {
+            tables->pawn_probes++;
+            EvalCache::Pawn_Entry &entry = tables->pawns[pawn_hash & (EvalCache::Pawn_Entries - 1)];
+            if (entry.key == pawn_hash) {
+                tables->pawn_hits++;
+            } else {
+                entry.key = pawn_hash;
+                entry.score = evaluate_pawns();
+            }
+            pawn_score = entry.score;
+        } else pawn_score = evaluate_pawns();
+        int score = material_pst + pawn_score;
+        // blend middlegame and endgame by the material left, promotions can push the phase past the maximum
+        int middlegame_phase = min(phase, Max_Phase);
+        value = (Get_Middlegame_Value(score) * middlegame_phase +
+                 Get_Endgame_Value(score) * (Max_Phase - middlegame_phase)) / Max_Phase;
+        if (!white_move) value = -value;
+        if (Activity_Terms) {
+            // lazy exit: mobility and king safety rarely move the score by Lazy_Margin, so an estimate that far
+            // outside the window already decides the cutoff. It is cached marked as an estimate.
+            if (tables != nullptr) tables->lazy_calls++;
+            if (value + Lazy_Margin <= alpha || value - Lazy_Margin >= beta) {
+                if (tables != nullptr) {
+                    tables->lazy_exits++;
+                    cached->key = key;
+                    cached->value = value;
+                    cached->lazy = true;
+                }
+                return value;
+            }
+            score += evaluate_activity();
+            value = (Get_Middlegame_Value(score) * middlegame_phase +
+                     Get_Endgame_Value(score) * (Max_Phase - middlegame_phase)) / Max_Phase;
+            if (!white_move) value = -value;
+        }
+    }
+    if (cached != nullptr) {
+        cached->key = key;
+        cached->value = value;
+        cached->lazy = false;
     }
-    if (!white_move) value = -value;
     return value;
 }
 
-Move Position::get_best_move() {
+Move Position::get_best_move(double seconds, bool verbose) {
+    // book moves and positions the endgame tables cover need no search
+    if (PolyglotBook::pick(*this, best_move)) {
+        if (verbose) cout << "book move:  " << best_move.to_letter_string() << endl;
+        return best_move;
+    }
+    if (Tablebase::root_move(*this, best_move)) {
+        if (verbose) cout << "tablebase move:  " << best_move.to_letter_string() << endl;
+        return best_move;
+    }
+    vector<Move> table_moves;
+    if (Syzygy::Enabled && Syzygy::root_moves(*this, table_moves)) {
+        best_move = table_moves[0];
+        if (verbose) cout << "syzygy move:  " << best_move.to_letter_string() << " (dtz " << best_move.value << ")" << endl;
+        return best_move;
+    }
     vector<Move> legal_moves = get_all_legal_moves();
     std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
     std::chrono::steady_clock::time_point end;
     double time_passed = 0.0;
     int i = 1;
-    for (; time_passed < 1.0; ++i) {
-        int value = minimax(i, i, -30000, 30000);
+    for (; time_passed < seconds; ++i) {
+        int value;
+        {
+            Trace::Span span("iteration", "depth", i);
+            value = minimax(i, i, -30000, 30000);
+        }
         end = std::chrono::steady_clock::now();
         if (value == -25000){
             return get_all_legal_moves()[0];
         }
         time_passed = ((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000);
+        Trace::instant("time check", time_passed < seconds ? "continue" : "stop", time_passed);
     }
-    cout << "computed best move:  " << best_move.to_letter_string() << " (depth " << i - 1 << ") in " << time_passed <<
-    " seconds" << endl;
+    if (verbose) cout << "computed best move:  " << best_move.to_letter_string() << " (depth " << i - 1 << ") in " <<
+                      time_passed << " seconds" << endl;
     return best_move;
 }
 
@@ -623,17 +1563,22 @@ int Position::minimax_parallel(int depth, int alpha, int beta) {
     int max_value = -25000;
 #pragma omp parallel num_threads(omp_get_max_threads())
     {
+        PerfCounters::Thread_Scope perf_scope;
 #pragma omp for schedule(dynamic, 2)
         for (Move move : legal_moves) {
+            Trace::Span span("root move", move);
             Position p = copy();
             p.make_move(move);
             int local_value = -p.minimax(depth-1, depth-1, alpha, beta);
             Move local_move = p.best_move;
             #pragma omp critical
-            if (local_value > max_value){
-                max_value = local_value;
-                best_move = local_move;
-                best_move.value = max_value;
+            {
+                nodes += p.nodes;
+                if (local_value > max_value){
+                    max_value = local_value;
+                    best_move = local_move;
+                    best_move.value = max_value;
+                }
             }
         }
     }
@@ -641,6 +1586,7 @@ int Position::minimax_parallel(int depth, int alpha, int beta) {
 }
 
 void Position::sort_moves(vector<Move> &moves) {
+    ALLOC_SITE(AllocTracker::Sort_Moves);
     // evaluate moves:
     int move_score;
     int figure_type;
@@ -668,6 +1614,26 @@ void Position::sort_moves(vector<Move> &moves) {
 }
 
 int Position::minimax(int depth, int max_depth, int alpha, int beta) {
+    nodes++;
+    PROFILE_COUNT(Profiler::Search_Node);
+    ALLOC_SITE(AllocTracker::Minimax);
+    if (depth < max_depth && Tablebase::largest() > 0) {
+        int wdl;
+        int dtm;
+        if (Tablebase::probe(*this, wdl, dtm)) {
+            if (wdl == Tablebase::Draw) return 0;
+            return wdl == Tablebase::Win ? Tablebase::Win_Score - dtm : dtm - Tablebase::Win_Score;
+        }
+    }
+    // Syzygy results count the fifty-move rule from the last zeroing move, so they are probed right after one
+    if (depth < max_depth && halfmove_clock == 0 && Syzygy::Enabled && Syzygy::largest() > 0) {
+        int wdl;
+        if (Syzygy::probe_wdl(*this, wdl)) {
+            if (wdl == Syzygy::Win) return Syzygy::Win_Score - (max_depth - depth);
+            if (wdl == Syzygy::Loss) return (max_depth - depth) - Syzygy::Win_Score;
+            return wdl; // draws, and the wins and losses the fifty-move rule turns into draws
+        }
+    }
     if (depth == 0) return search_captures(alpha, beta);
     vector<Move> moves = get_all_pseudolegal_moves();
     sort_moves(moves);
@@ -693,7 +1659,10 @@ int Position::minimax(int depth, int max_depth, int alpha, int beta) {
 }
 
 int Position::search_captures(int alpha, int beta) {
-    int eval = evaluate();
+    nodes++;
+    PROFILE_COUNT(Profiler::Quiescence_Node);
+    ALLOC_SITE(AllocTracker::Search_Captures);
+    int eval = evaluate(alpha, beta);
     if (eval >= beta) return beta;
     alpha = max(alpha, eval);
     vector<Move> capture_moves = get_all_pseudolegal_capture_moves();
@@ -710,6 +1679,7 @@ int Position::search_captures(int alpha, int beta) {
 }
 
 vector<Move> Position::get_all_pseudolegal_capture_moves() {
+    ALLOC_SITE(AllocTracker::Capture_Moves);
     vector<Move> capture_moves;
     for (int i = 0; i < 64; ++i) {
         if (is_it_your_turn(chessboard[i])) {
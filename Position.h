@@ -1,5 +1,8 @@
 #include "Figure.h"
 #include "Move.h"
+#include "Zobrist.h"
+#include "PerftTable.h"
+#include "Nnue.h"
 #include <vector>
 
 using namespace std;
@@ -9,6 +12,38 @@ using namespace std;
 
 #include <string>
 
+// Move classes counted at the last ply by Position::perft_stats, as in the published perft tables.
+struct Perft_Stats {
+    long long int nodes;
+    long long int captures;
+    long long int en_passants;
+    long long int castles;
+    long long int promotions;
+    long long int checks;
+    long long int discovered_checks;
+    long long int double_checks;
+    long long int checkmates;
+
+    Perft_Stats() : nodes(0), captures(0), en_passants(0), castles(0), promotions(0), checks(0),
+                    discovered_checks(0), double_checks(0), checkmates(0) {};
+    void add(const Perft_Stats &other);
+};
+
+// A board filled figure by figure by set_fen or PackedPosition::unpack. The keys, score and phase are summed up on
+// the way instead of by the compute_ functions; Position::set_board checks the rest and takes it.
+struct Board_Setup {
+    int board[64];
+    int kings[2]; // white, black
+    unsigned long long piece_key;
+    unsigned long long pawn_key;
+    int score;
+    int weight;
+    bool valid; // no pawn on the first or last row, at most one king each
+
+    Board_Setup() : board(), kings{ -1, -1 }, piece_key(0), pawn_key(0), score(0), weight(0), valid(true) {};
+    inline void place(int code, int square);
+};
+
 class Position {
 public:
 
@@ -19,9 +54,15 @@ public:
     static const int W_King_Start_Index = 4;
     static const int B_King_Start_Index = 60;
     const static string Start_FEN;
+    static PerftTable Perft_Table; // shared by all perft threads, disabled until resized
+    static bool Activity_Terms; // mobility and king safety in evaluate()
+    static int Square_Values[24][64]; // middlegame/endgame score (Make_Score) by figure code and square, 0 if empty
 
     explicit Position() : Position(Start_FEN) {};
-    explicit Position(string fen);
+    explicit Position(string fen); // the start position if fen is not valid
+    static const int Max_Fen_Length = 100; // including the terminating zero
+    static const int Max_Halfmove_Clock = 511; // kept in 9 bits of Move.info for undo_move, make_move stops there
+    static const int Max_San_Length = 8; // including the terminating zero
     static int Get_Row_By_Index(int index);
     static int Get_Column_By_Index(int index);
     static int Get_Index_By_Row_And_Column(int row, int column);
@@ -42,8 +83,42 @@ public:
     int halfmove_clock; // number of halfmoves since the last capture or pawn advance, used for fifty-move rule
     int fullmove_number; // number of the full move. starts at 1, and is incremented after black's move
     Move best_move;
+    long long int nodes; // search nodes (minimax + search_captures) visited since the last reset
+    unsigned long long hash; // Zobrist key, updated incrementally by make_move/undo_move
+    unsigned long long pawn_hash; // Zobrist key of the pawns only, keys the pawn structure table
+    int material_pst; // packed material + piece-square score from white's view, updated incrementally like hash
+    int phase; // sum of Phase_Weights of the figures on the board, Max_Phase at the start
+    Nnue::Accumulator accumulator; // first network layer per perspective, only kept while Nnue::Enabled
 
     void print_board();
+    // parses without allocating; false (and the position unchanged) if the FEN is not valid. The halfmove clock and
+    // fullmove number may be left out.
+    bool set_fen(const char *fen, size_t length);
+    // sets up the position from a filled board and the rest of the state (castling rights K Q k q in bits 0-3,
+    // en passant 128 for none). Checks the figures, the castling rights, the en passant square and the clock; false
+    // (and the position unchanged) if the board does not allow them.
+    bool set_board(const Board_Setup &setup, bool white, int castling_rights, int en_passant, int halfmove,
+                   int fullmove);
+    // writes the FEN and a terminating zero into a buffer of Max_Fen_Length, returns the length
+    size_t write_fen(char *buffer);
+    string to_fen();
+    // the legal move written in standard algebraic notation (e.g. Nbd7, exd8=Q+, O-O), false if there is no such
+    // move or more than one. Castling may be written with zeros, a promotion without '=', and check marks and
+    // annotations (+ # ! ?) are ignored.
+    bool parse_san(const char *san, size_t length, Move &move);
+    // writes the SAN of a legal move and a terminating zero into a buffer of Max_San_Length, returns the length
+    size_t write_san(Move move, char *buffer);
+    string to_san(Move move);
+    int get_castling_rights();
+    unsigned long long compute_hash();
+    unsigned long long compute_pawn_hash();
+    int evaluate_pawns();
+    int evaluate_activity();
+    unsigned long long get_attacks(int index);
+    int compute_material_pst();
+    int compute_phase();
+    void update_accumulator(Move &move, int sign);
+    void refresh_accumulator();
     Position copy();
     vector<Move> get_pseudolegal_moves(int index);
     bool is_no_figure_between(int index1, int index2, int i);
@@ -51,6 +126,9 @@ public:
     vector<Move> get_all_pseudolegal_moves();
     vector<Move> get_all_pseudolegal_capture_moves();
     vector<Move> get_all_legal_moves();
+    void filter_legal_moves(vector<Move> &moves);
+    int count_legal_moves();
+    bool is_king_move_safe(int from, int to);
     void make_move(Move &move);
     void undo_move(Move move);
     bool is_hanging(int index);
@@ -58,16 +136,37 @@ public:
     bool is_threatened(int index);
     bool is_threatened_by_pawn(int index);
     long long int perft_divide(int depth, int max_depth);
-    long long int perft_divide_parallel(int depth);
+    long long int perft_divide_parallel(int depth, const string &checkpoint_file = "");
     long long int perft(int depth);
     long long int perft_parallel(int depth);
+    long long int perft_bulk(int depth);
+    int get_checkers(int checker_squares[]);
+    void perft_stats(int depth, Perft_Stats &stats);
+    Perft_Stats perft_stats_parallel(int depth);
+    long long int perft_bulk_parallel(int depth);
     long long int other_perft(int depth);
-    int evaluate();
+    static const int Lazy_Margin = 250; // bound on the mobility and king safety terms for the lazy exit
+    int evaluate(int alpha = -30000, int beta = 30000); // may return a cheaper estimate outside [alpha, beta]
     int minimax(int depth, int max_depth, int alpha, int beta);
     int search_captures(int alpha, int beta);
     void sort_moves(vector<Move> &moves);
-    Move get_best_move();
+    Move get_best_move(double seconds = 1.0, bool verbose = true); // iterative deepening until seconds have passed
     int  minimax_parallel(int depth, int alpha, int beta);
 };
 
+inline void Board_Setup::place(int code, int square) {
+    int type = Get_Type(code);
+    if (type == Pawn && (square < 8 || square >= 56)) valid = false;
+    if (type == King) {
+        int &king = kings[Is_White(code) ? 0 : 1];
+        if (king != -1) valid = false;
+        king = square;
+    }
+    board[square] = code;
+    piece_key ^= Zobrist::Pieces[code][square];
+    pawn_key ^= Zobrist::Pawns[code][square];
+    score += Position::Square_Values[code][square];
+    weight += Phase_Weights[type];
+}
+
 #endif //CHESS_POSITION_H
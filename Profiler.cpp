@@ -0,0 +1,103 @@
+#include "Profiler.h"
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+const char *const Profiler::Counter_Names[Profiler::Counter_Count] = {
+        "gen pawn", "gen knight", "gen bishop", "gen rook", "gen queen", "gen king",
+        "is_hanging", "is_no_figure_between", "make_move", "evaluate",
+        "search node", "quiescence node", "perft node"
+};
+
+const int Profiler::Gen_By_Type[8] = {
+        Gen_Pawn, Gen_King, Gen_Pawn, Gen_Knight, Gen_Pawn, Gen_Bishop, Gen_Rook, Gen_Queen
+};
+
+static mutex registry_mutex;
+static vector<unique_ptr<Profiler::Counters>> registry; // one block per thread that ever counted something
+
+static string region_name;
+static unsigned long long region_start_cycles = 0;
+static std::chrono::steady_clock::time_point region_start_time;
+static bool has_report = false;
+static Profiler::Counters report;
+static unsigned long long report_cycles = 0;
+static double report_seconds = 0.0;
+static int report_threads = 0;
+
+Profiler::Counters *Profiler::register_thread() {
+    unique_ptr<Counters> counters(new Counters());
+    memset(counters.get(), 0, sizeof(Counters));
+    lock_guard<mutex> lock(registry_mutex);
+    registry.push_back(move(counters));
+    return registry.back().get();
+}
+
+void Profiler::begin_region(const string &name) {
+    lock_guard<mutex> lock(registry_mutex);
+    for (auto &counters : registry) memset(counters.get(), 0, sizeof(Counters));
+    region_name = name;
+    region_start_time = std::chrono::steady_clock::now();
+    region_start_cycles = read_cycles();
+}
+
+void Profiler::end_region() {
+    unsigned long long end_cycles = read_cycles();
+    std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+    lock_guard<mutex> lock(registry_mutex);
+    memset(&report, 0, sizeof(report));
+    report_threads = 0;
+    for (auto &counters : registry) {
+        bool active = false;
+        for (int i = 0; i < Counter_Count; ++i) {
+            report.calls[i] += counters->calls[i];
+            report.cycles[i] += counters->cycles[i];
+            if (counters->calls[i] != 0) active = true;
+        }
+        if (active) report_threads++;
+    }
+    report_cycles = end_cycles - region_start_cycles;
+    report_seconds = (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - region_start_time).count() / 1000000;
+    has_report = true;
+}
+
+void Profiler::print_report() {
+#ifndef CHESS_PROFILE
+    cout << "profiling is disabled in this build (configure with -DCHESS_PROFILE=ON)" << endl;
+#else
+    if (!has_report) {
+        cout << "nothing profiled yet, run perft, divide, calculate or bench first" << endl;
+        return;
+    }
+    // cycles are inclusive (is_hanging contains its is_no_figure_between calls), shares are relative to the
+    // wall-clock cycles of the region times the number of threads that did any counted work
+    unsigned long long budget = report_cycles * max(report_threads, 1);
+    vector<int> order;
+    for (int i = 0; i < Counter_Count; ++i) if (report.calls[i] != 0) order.push_back(i);
+    sort(order.begin(), order.end(), [](int lhs, int rhs) { return report.cycles[lhs] > report.cycles[rhs]; });
+    cout << "profile of '" << region_name << "': " << report_seconds << " seconds, " << report_cycles <<
+         " cycles, " << report_threads << " thread(s)" << endl;
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << left << setw(24) << "counter" << right << setw(16) << "calls" << setw(18) << "cycles" <<
+         setw(14) << "cycles/call" << setw(10) << "share" << endl;
+    for (int i : order) {
+        cout << left << setw(24) << Counter_Names[i] << right << setw(16) << report.calls[i];
+        if (report.cycles[i] == 0) {
+            cout << setw(18) << "-" << setw(14) << "-" << setw(10) << "-" << endl; // counted, not timed
+            continue;
+        }
+        cout << setw(18) << report.cycles[i] << setw(14) << fixed << setprecision(1) <<
+             (double) report.cycles[i] / report.calls[i] << setw(9) << 100.0 * report.cycles[i] / budget << "%" << endl;
+    }
+    cout.flags(flags);
+    cout.precision(precision);
+#endif
+}
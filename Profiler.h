@@ -0,0 +1,89 @@
+#include <string>
+
+#ifndef CHESS_PROFILER_H
+#define CHESS_PROFILER_H
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+using namespace std;
+
+// Hot-path counters and timers. Configure with -DCHESS_PROFILE=ON to count calls and cycles of the hot functions,
+// in a normal build every PROFILE_* macro expands to nothing. PROFILE_SCOPE times the rest of the enclosing block,
+// PROFILE_COUNT only counts (used for recursive search nodes, where inclusive cycles would be meaningless).
+class Profiler {
+public:
+    static const int Gen_Pawn = 0; // get_pseudolegal_moves, split by piece type
+    static const int Gen_Knight = 1;
+    static const int Gen_Bishop = 2;
+    static const int Gen_Rook = 3;
+    static const int Gen_Queen = 4;
+    static const int Gen_King = 5;
+    static const int Is_Hanging = 6;
+    static const int Is_No_Figure_Between = 7;
+    static const int Make_Move = 8;
+    static const int Evaluate = 9;
+    static const int Search_Node = 10; // minimax nodes
+    static const int Quiescence_Node = 11; // search_captures nodes
+    static const int Perft_Node = 12;
+    static const int Counter_Count = 13;
+    static const char *const Counter_Names[Counter_Count];
+    static const int Gen_By_Type[8]; // figure type -> move generation counter
+
+    struct Counters {
+        unsigned long long calls[Counter_Count];
+        unsigned long long cycles[Counter_Count];
+    };
+
+    static inline unsigned long long read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+    // counters of the calling thread, registered on first use so that end_region() can sum them up
+    static inline Counters &thread_counters() {
+        static thread_local Counters *counters = nullptr;
+        if (counters == nullptr) counters = register_thread();
+        return *counters;
+    }
+    static void begin_region(const string &name);
+    static void end_region();
+    static void print_report();
+
+private:
+    static Counters *register_thread();
+};
+
+class Profile_Scope {
+public:
+    explicit Profile_Scope(int counter) : counter(counter), start(Profiler::read_cycles()) {};
+    ~Profile_Scope() {
+        Profiler::Counters &counters = Profiler::thread_counters();
+        counters.calls[counter]++;
+        counters.cycles[counter] += Profiler::read_cycles() - start;
+    }
+private:
+    int counter;
+    unsigned long long start;
+};
+
+#ifdef CHESS_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(counter) Profile_Scope PROFILE_CONCAT(profile_scope_, __LINE__)(counter)
+#define PROFILE_COUNT(counter) Profiler::thread_counters().calls[counter]++
+#define PROFILE_BEGIN(name) Profiler::begin_region(name)
+#define PROFILE_END() Profiler::end_region()
+#else
+#define PROFILE_SCOPE(counter)
+#define PROFILE_COUNT(counter)
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#endif
+
+#endif //CHESS_PROFILER_H
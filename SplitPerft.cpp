@@ -0,0 +1,98 @@
+#include "SplitPerft.h"
+#include "PerfCounters.h"
+#include "Trace.h"
+#include <omp.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+struct Split_Task {
+    Position position; // after the moves leading to this subtree
+    int depth; // remaining depth
+    int ply; // plies below the root
+    int root; // index of the root move this subtree belongs to
+};
+
+struct Worker_Queue {
+    mutex lock;
+    deque<Split_Task> tasks;
+};
+
+long long int SplitPerft::run(Position &root, int depth, int split_depth, vector<long long int> &root_counts) {
+    vector<Move> root_moves = root.get_all_legal_moves();
+    root_counts.assign(root_moves.size(), 0);
+    if (depth <= 0) return 1;
+    int workers = omp_get_max_threads();
+    unique_ptr<Worker_Queue[]> queues(new Worker_Queue[workers]);
+    atomic<long long int> outstanding((long long int) root_moves.size());
+    for (size_t i = 0; i < root_moves.size(); ++i) {
+        Split_Task task = {root, depth - 1, 1, (int) i};
+        Move move = Move(root_moves[i].from, root_moves[i].to, root_moves[i].info & Move::promotion_type_mask);
+        task.position.make_move(move);
+        queues[i % workers].tasks.push_back(task);
+    }
+    vector<vector<long long int>> worker_counts(workers, vector<long long int>(root_moves.size(), 0));
+#pragma omp parallel num_threads(workers)
+    {
+        PerfCounters::Thread_Scope perf_scope;
+        int self = omp_get_thread_num();
+        Worker_Queue &own = queues[self];
+        vector<long long int> &counts = worker_counts[self];
+        unsigned int random = 2654435761u * (self + 1);
+        Split_Task task;
+        while (outstanding.load(memory_order_acquire) > 0) {
+            bool found = false;
+            {
+                lock_guard<mutex> guard(own.lock);
+                if (!own.tasks.empty()) {
+                    task = own.tasks.back();
+                    own.tasks.pop_back();
+                    found = true;
+                }
+            }
+            for (int attempt = 0; !found && attempt < workers - 1; ++attempt) {
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                Worker_Queue &victim = queues[random % workers];
+                if (&victim == &own) continue;
+                lock_guard<mutex> guard(victim.lock);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    found = true;
+                }
+            }
+            if (!found) {
+                this_thread::yield();
+                continue;
+            }
+            if (task.ply < split_depth && task.depth >= 2) {
+                vector<Move> moves = task.position.get_all_pseudolegal_moves();
+                task.position.filter_legal_moves(moves);
+                // count the children in before this task is counted out, so outstanding never drops to 0 early
+                outstanding.fetch_add((long long int) moves.size(), memory_order_acq_rel);
+                lock_guard<mutex> guard(own.lock);
+                for (Move move : moves) {
+                    Split_Task child = {task.position, task.depth - 1, task.ply + 1, task.root};
+                    child.position.make_move(move);
+                    own.tasks.push_back(child);
+                }
+            } else {
+                Trace::Span span("split task", "depth", task.depth);
+                counts[task.root] += task.position.perft_bulk(task.depth);
+            }
+            outstanding.fetch_sub(1, memory_order_acq_rel);
+        }
+    }
+    long long int total = 0;
+    for (size_t i = 0; i < root_moves.size(); ++i) {
+        for (int w = 0; w < workers; ++w) root_counts[i] += worker_counts[w][i];
+        total += root_counts[i];
+    }
+    return total;
+}
@@ -0,0 +1,20 @@
+#include "Position.h"
+#include <vector>
+
+#ifndef CHESS_SPLITPERFT_H
+#define CHESS_SPLITPERFT_H
+
+using namespace std;
+
+// Task-based parallel perft. Unlike perft_parallel, which only splits over the root moves, the tree is split
+// into tasks down to split_depth plies. Every worker owns a deque of tasks: it pushes and pops its own work at
+// the back and, when that runs dry, steals the oldest (biggest) task from the front of a random other worker.
+// Tasks carry their own Position copy, so workers never share a board.
+class SplitPerft {
+public:
+    static const int Default_Split_Depth = 2;
+    // returns the total, root_counts receives the count per legal root move (in get_all_legal_moves order)
+    static long long int run(Position &root, int depth, int split_depth, vector<long long int> &root_counts);
+};
+
+#endif //CHESS_SPLITPERFT_H
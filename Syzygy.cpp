@@ -0,0 +1,799 @@
+#include "Syzygy.h"
+#include "Figure.h"
+#include <unordered_map>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+bool Syzygy::Enabled = false;
+atomic<unsigned long long> Syzygy::Probes(0);
+atomic<unsigned long long> Syzygy::Hits(0);
+
+static const uint8_t Wdl_Magic[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t Dtz_Magic[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+static const string Name_Letters = "KQRBNP";
+static const int Name_Types[6] = { King, Queen, Rook, Bishop, Knight, Pawn };
+// Syzygy piece code by figure type: pawn 1 .. king 6, black adds 8
+static const int Piece_Codes[8] = { 0, 6, 1, 2, 0, 3, 4, 5 };
+
+// flags of a compressed table
+static const int Side_Flag = 1; // dtz: the side to move the table holds, 1 for black
+static const int Mapped_Flag = 2; // dtz: values go through a map
+static const int Win_Plies_Flag = 4; // dtz of wins in plies, in moves otherwise
+static const int Loss_Plies_Flag = 8;
+static const int Wide_Flag = 16; // dtz map of 16 bit values
+static const int Single_Value_Flag = 128; // every position has the same value
+
+// result of a table lookup or a search over the zeroing moves
+static const int Probe_Fail = 0;
+static const int Probe_Ok = 1;
+static const int Probe_Zeroing = 2; // the best move is a zeroing move, the table value may not hold
+static const int Probe_Change_Side = 3; // the dtz table holds the other side to move
+
+// one compressed table: a side to move and, with pawns, the file of the leading pawn
+struct Pairs {
+    int flags;
+    size_t block_size;
+    size_t span; // values between two sparse index entries
+    uint32_t blocks;
+    int max_length; // of a Huffman code
+    int min_length; // or the value of a single value table
+    const uint8_t *lowest_symbol; // uint16 by code length - min_length: the symbol of the lowest code
+    vector<uint64_t> base; // by code length - min_length: the lowest code, left aligned in 64 bits
+    vector<uint8_t> symbol_length; // number of values a symbol stands for, minus one
+    const uint8_t *tree; // 3 bytes per symbol: the left and right symbol it pairs, 12 bits each
+    const uint8_t *block_length; // uint16 per block: the number of values minus one
+    size_t block_length_size;
+    const uint8_t *sparse_index; // 6 bytes per span: uint32 block and uint16 offset of the value in its middle
+    size_t sparse_index_size;
+    const uint8_t *data;
+    int pieces[Syzygy::Max_Figures]; // Syzygy piece codes in index order
+    uint64_t group_index[Syzygy::Max_Figures + 1]; // factor of every group of the index, then the table size
+    int group_length[Syzygy::Max_Figures + 1]; // figures per group, zero terminated
+    uint16_t map_index[4]; // dtz: start of the map of wins, losses, cursed wins and blessed losses
+};
+
+struct Syzygy_Table {
+    unsigned long long key; // signature with the first side of the name as white
+    unsigned long long key2; // and as black
+    int figures;
+    bool has_pawns;
+    bool unique_pieces; // a figure other than the king that a side has only once
+    int pawn_count[2]; // of the leading colour, the side with fewer pawns, and of the other one
+    bool dtz;
+    const uint8_t *map;
+    void *mapping;
+    size_t size;
+    Pairs items[2][4]; // by side to move (wdl of an asymmetric material only) and file of the leading pawn
+
+    Pairs &get(int side, int file) { return items[dtz ? 0 : side][has_pawns ? file : 0]; }
+};
+
+struct Syzygy_Entry {
+    Syzygy_Table wdl;
+    Syzygy_Table dtz;
+    bool has_dtz;
+};
+
+// index tables of the format
+static int Map_Pawns[64]; // a2-h7 to 47..0, from the edge files inwards and upwards
+static int Map_B1H1H7[64]; // squares below the a1-h8 diagonal to 0..27
+static int Map_A1D1D4[64]; // the a1-d1-d4 triangle to 0..9, diagonal last
+static int Map_KK[10][64]; // the 462 positions of two kings with the first in the triangle
+static uint64_t Binomial[Syzygy::Max_Figures][64];
+static int Lead_Pawn_Index[Syzygy::Max_Figures][64];
+static int Lead_Pawns_Size[Syzygy::Max_Figures][4]; // by number of leading pawns and file
+
+// entries by material signature of both colours, written only by load() while no search runs
+static vector<Syzygy_Entry> entries;
+static unordered_map<unsigned long long, size_t> entry_by_key;
+static int largest_figures = 0;
+static int dtz_count = 0;
+
+static inline int off_diagonal(int square) {
+    return (square >> 3) - (square & 7);
+}
+
+static void init_tables() {
+    static bool done = false;
+    if (done) return;
+    done = true;
+    int code = 0;
+    for (int square = 0; square < 64; ++square) if (off_diagonal(square) < 0) Map_B1H1H7[square] = code++;
+    vector<int> diagonal;
+    code = 0;
+    for (int square = 0; square <= 27; ++square) {
+        if (off_diagonal(square) < 0 && (square & 7) <= 3) Map_A1D1D4[square] = code++;
+        else if (off_diagonal(square) == 0 && (square & 7) <= 3) diagonal.push_back(square);
+    }
+    for (int square : diagonal) Map_A1D1D4[square] = code++;
+    // kings not next to each other; with the first on the diagonal the second is not above it, and both on the
+    // diagonal come last
+    vector<pair<int, int>> both_on_diagonal;
+    code = 0;
+    for (int index = 0; index < 10; ++index) {
+        for (int first = 0; first <= 27; ++first) {
+            if (Map_A1D1D4[first] != index || (index == 0 && first != 1)) continue;
+            for (int second = 0; second < 64; ++second) {
+                if (abs((first >> 3) - (second >> 3)) <= 1 && abs((first & 7) - (second & 7)) <= 1) continue;
+                if (off_diagonal(first) == 0 && off_diagonal(second) > 0) continue;
+                if (off_diagonal(first) == 0 && off_diagonal(second) == 0) both_on_diagonal.emplace_back(index, second);
+                else Map_KK[index][second] = code++;
+            }
+        }
+    }
+    for (auto &kings : both_on_diagonal) Map_KK[kings.first][kings.second] = code++;
+    Binomial[0][0] = 1;
+    for (int n = 1; n < 64; ++n) {
+        for (int k = 0; k < Syzygy::Max_Figures && k <= n; ++k) {
+            Binomial[k][n] = (k > 0 ? Binomial[k - 1][n - 1] : 0) + (k < n ? Binomial[k][n - 1] : 0);
+        }
+    }
+    int available = 47;
+    for (int lead = 1; lead < Syzygy::Max_Figures - 1; ++lead) {
+        for (int file = 0; file < 4; ++file) {
+            int index = 0;
+            for (int row = 1; row <= 6; ++row) {
+                int square = row * 8 + file;
+                if (lead == 1) {
+                    Map_Pawns[square] = available--;
+                    Map_Pawns[square ^ 7] = available--;
+                }
+                Lead_Pawn_Index[lead][square] = index;
+                index += (int) Binomial[lead - 1][Map_Pawns[square]];
+            }
+            Lead_Pawns_Size[lead][file] = index;
+        }
+    }
+}
+
+static inline uint16_t read16(const uint8_t *data) {
+    return (uint16_t) (data[0] | data[1] << 8);
+}
+
+static inline uint32_t read32(const uint8_t *data) {
+    return (uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+static inline uint32_t read32_big_endian(const uint8_t *data) {
+    return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 | (uint32_t) data[2] << 8 | (uint32_t) data[3];
+}
+
+static inline int left_symbol(const uint8_t *tree, int symbol) {
+    const uint8_t *node = tree + 3 * symbol;
+    return (node[1] & 0xF) << 8 | node[0];
+}
+
+static inline int right_symbol(const uint8_t *tree, int symbol) {
+    const uint8_t *node = tree + 3 * symbol;
+    return node[2] << 4 | node[1] >> 4;
+}
+
+static inline const uint8_t *align(const uint8_t *data, uintptr_t alignment) {
+    return (const uint8_t *) (((uintptr_t) data + alignment - 1) & ~(alignment - 1));
+}
+
+// 4 bits per (colour, figure type) count, white first
+static inline unsigned long long signature(const int counts[2][8]) {
+    unsigned long long key = 0;
+    for (int colour = 0; colour < 2; ++colour) {
+        for (int type = 0; type < 8; ++type) key = (key << 4) | (unsigned long long) counts[colour][type];
+    }
+    return key;
+}
+
+// "KRvKN" -> the figure counts of the table; false for anything that is not a valid name
+static bool describe(const string &material, Syzygy_Table &table) {
+    size_t separator = material.find('v');
+    if (separator == string::npos || material.size() - 1 > (size_t) Syzygy::Max_Figures) return false;
+    int counts[2][8] = {};
+    for (int colour = 0; colour < 2; ++colour) {
+        string side = colour == 0 ? material.substr(0, separator) : material.substr(separator + 1);
+        if (side.empty() || side[0] != 'K') return false;
+        size_t last = 0;
+        for (size_t i = 0; i < side.size(); ++i) {
+            size_t piece = Name_Letters.find(side[i]);
+            if (piece == string::npos || (i == 0) != (piece == 0) || piece < last) return false;
+            last = piece;
+            counts[colour][Name_Types[piece]]++;
+        }
+    }
+    int swapped[2][8];
+    memcpy(swapped[0], counts[1], sizeof(swapped[0]));
+    memcpy(swapped[1], counts[0], sizeof(swapped[1]));
+    table.key = signature(counts);
+    table.key2 = signature(swapped);
+    table.figures = (int) material.size() - 1;
+    table.has_pawns = counts[0][Pawn] + counts[1][Pawn] > 0;
+    table.unique_pieces = false;
+    for (int colour = 0; colour < 2; ++colour) {
+        for (int type : { Pawn, Knight, Bishop, Rook, Queen }) if (counts[colour][type] == 1) table.unique_pieces = true;
+    }
+    // the leading pawns are those of the side with fewer pawns, white if both have as many
+    bool white_leads = counts[1][Pawn] == 0 || (counts[0][Pawn] > 0 && counts[1][Pawn] >= counts[0][Pawn]);
+    table.pawn_count[0] = counts[white_leads ? 0 : 1][Pawn];
+    table.pawn_count[1] = counts[white_leads ? 1 : 0][Pawn];
+    table.dtz = false;
+    table.map = nullptr;
+    table.mapping = nullptr;
+    table.size = 0;
+    return true;
+}
+
+// the factors of the groups of figures the index is made of, in the order the table stores them
+static void set_groups(const Syzygy_Table &table, Pairs &d, const int order[2], int file) {
+    int n = 0;
+    int first_length = table.has_pawns ? 0 : table.unique_pieces ? 3 : 2;
+    d.group_length[n] = 1;
+    for (int i = 1; i < table.figures; ++i) {
+        if (--first_length > 0 || d.pieces[i] == d.pieces[i - 1]) d.group_length[n]++;
+        else d.group_length[++n] = 1;
+    }
+    d.group_length[++n] = 0;
+    bool both_pawns = table.has_pawns && table.pawn_count[1] > 0;
+    int next = both_pawns ? 2 : 1;
+    int free_squares = 64 - d.group_length[0] - (both_pawns ? d.group_length[1] : 0);
+    uint64_t index = 1;
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d.group_index[0] = index;
+            index *= table.has_pawns ? Lead_Pawns_Size[d.group_length[0]][file] : table.unique_pieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d.group_index[1] = index;
+            index *= Binomial[d.group_length[1]][48 - d.group_length[0]];
+        } else {
+            d.group_index[next] = index;
+            index *= Binomial[d.group_length[next]][free_squares];
+            free_squares -= d.group_length[next++];
+        }
+    }
+    d.group_index[n] = index;
+}
+
+static uint8_t set_symbol_length(Pairs &d, int symbol, vector<bool> &visited) {
+    visited[symbol] = true;
+    int right = right_symbol(d.tree, symbol);
+    if (right == 0xFFF) return 0;
+    int left = left_symbol(d.tree, symbol);
+    if (left >= (int) visited.size() || right >= (int) visited.size()) return 0;
+    if (!visited[left]) d.symbol_length[left] = set_symbol_length(d, left, visited);
+    if (!visited[right]) d.symbol_length[right] = set_symbol_length(d, right, visited);
+    return (uint8_t) (d.symbol_length[left] + d.symbol_length[right] + 1);
+}
+
+// the block sizes and the Huffman code of a table, nullptr if they make no sense
+static const uint8_t *set_sizes(Pairs &d, const uint8_t *data) {
+    d.flags = *data++;
+    if (d.flags & Single_Value_Flag) {
+        d.blocks = 0;
+        d.block_length_size = d.span = d.sparse_index_size = 0;
+        d.min_length = *data++;
+        return data;
+    }
+    uint64_t table_size = d.group_index[find(d.group_length, d.group_length + Syzygy::Max_Figures, 0) - d.group_length];
+    d.block_size = (size_t) 1 << *data++;
+    d.span = (size_t) 1 << *data++;
+    d.sparse_index_size = (size_t) ((table_size + d.span - 1) / d.span);
+    int padding = *data++;
+    d.blocks = read32(data);
+    data += 4;
+    d.block_length_size = d.blocks + padding; // so that the sparse index does not point past the end
+    d.max_length = *data++;
+    d.min_length = *data++;
+    if (d.min_length < 1 || d.max_length < d.min_length || d.max_length > 32) return nullptr;
+    d.lowest_symbol = data;
+    // canonical code: longer codes have lower values, so base[] decreases with the length
+    d.base.assign((size_t) (d.max_length - d.min_length + 1), 0);
+    for (int i = (int) d.base.size() - 2; i >= 0; --i) {
+        d.base[i] = (d.base[i + 1] + read16(d.lowest_symbol + 2 * i) - read16(d.lowest_symbol + 2 * (i + 1))) / 2;
+    }
+    for (size_t i = 0; i < d.base.size(); ++i) d.base[i] <<= 64 - i - d.min_length;
+    data += d.base.size() * 2;
+    d.symbol_length.assign(read16(data), 0);
+    data += 2;
+    d.tree = data;
+    vector<bool> visited(d.symbol_length.size());
+    for (size_t symbol = 0; symbol < d.symbol_length.size(); ++symbol) {
+        if (!visited[symbol]) d.symbol_length[symbol] = set_symbol_length(d, (int) symbol, visited);
+    }
+    return data + d.symbol_length.size() * 3 + (d.symbol_length.size() & 1);
+}
+
+static const uint8_t *set_dtz_map(Syzygy_Table &table, const uint8_t *data, int max_file) {
+    table.map = data;
+    for (int file = 0; file <= max_file; ++file) {
+        Pairs &d = table.get(0, file);
+        if (!(d.flags & Mapped_Flag)) continue;
+        if (d.flags & Wide_Flag) {
+            data = align(data, 2);
+            for (int i = 0; i < 4; ++i) {
+                d.map_index[i] = (uint16_t) ((data - table.map) / 2 + 1);
+                data += 2 * read16(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                d.map_index[i] = (uint16_t) (data - table.map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    return align(data, 2);
+}
+
+// reads the layout of a mapped file (after the magic), false if it does not fit the material or the file
+static bool set_layout(Syzygy_Table &table, const uint8_t *data, const uint8_t *end) {
+    static const int Split = 1;
+    static const int Has_Pawns = 2;
+    if (((*data & Has_Pawns) != 0) != table.has_pawns || ((*data & Split) != 0) != (table.key != table.key2)) return false;
+    data++;
+    int sides = !table.dtz && table.key != table.key2 ? 2 : 1;
+    int max_file = table.has_pawns ? 3 : 0;
+    bool both_pawns = table.has_pawns && table.pawn_count[1] > 0;
+    for (int file = 0; file <= max_file; ++file) {
+        int order[2][2] = { { *data & 0xF, both_pawns ? data[1] & 0xF : 0xF },
+                            { *data >> 4, both_pawns ? data[1] >> 4 : 0xF } };
+        data += 1 + both_pawns;
+        for (int k = 0; k < table.figures; ++k, ++data) {
+            for (int side = 0; side < sides; ++side) table.items[side][file].pieces[k] = side ? *data >> 4 : *data & 0xF;
+        }
+        for (int side = 0; side < sides; ++side) set_groups(table, table.items[side][file], order[side], file);
+    }
+    data = align(data, 2);
+    for (int file = 0; file <= max_file; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            data = set_sizes(table.items[side][file], data);
+            if (data == nullptr || data > end) return false;
+        }
+    }
+    if (table.dtz) data = set_dtz_map(table, data, max_file);
+    for (int file = 0; file <= max_file; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            Pairs &d = table.items[side][file];
+            d.sparse_index = data;
+            data += d.sparse_index_size * 6;
+        }
+    }
+    for (int file = 0; file <= max_file; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            Pairs &d = table.items[side][file];
+            d.block_length = data;
+            data += d.block_length_size * 2;
+        }
+    }
+    for (int file = 0; file <= max_file; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            Pairs &d = table.items[side][file];
+            data = align(data, 64);
+            d.data = data;
+            data += (size_t) d.blocks * d.block_size;
+        }
+    }
+    return data <= end;
+}
+
+static bool map_table(const string &filename, const uint8_t magic[4], Syzygy_Table &table) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size % 64 != 16) {
+        close(fd);
+        return false;
+    }
+    table.size = (size_t) info.st_size;
+    table.mapping = mmap(nullptr, table.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (table.mapping == MAP_FAILED) return false;
+    const uint8_t *data = (const uint8_t *) table.mapping;
+    if (memcmp(data, magic, 4) != 0 || !set_layout(table, data + 4, data + table.size)) {
+        munmap(table.mapping, table.size);
+        return false;
+    }
+    return true;
+}
+
+int Syzygy::load(const string &directory) {
+    init_tables();
+    for (Syzygy_Entry &entry : entries) {
+        munmap(entry.wdl.mapping, entry.wdl.size);
+        if (entry.has_dtz) munmap(entry.dtz.mapping, entry.dtz.size);
+    }
+    entries.clear();
+    entry_by_key.clear();
+    largest_figures = 0;
+    dtz_count = 0;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) return 0;
+    struct dirent *file_entry;
+    while ((file_entry = readdir(dir)) != nullptr) {
+        string name = file_entry->d_name;
+        if (name.size() <= 5 || name.compare(name.size() - 5, 5, ".rtbw") != 0) continue;
+        string material = name.substr(0, name.size() - 5);
+        Syzygy_Entry entry;
+        if (!describe(material, entry.wdl) || entry_by_key.count(entry.wdl.key) != 0) continue;
+        if (!map_table(directory + "/" + name, Wdl_Magic, entry.wdl)) continue;
+        entry.dtz = entry.wdl;
+        entry.dtz.dtz = true;
+        entry.has_dtz = map_table(directory + "/" + material + ".rtbz", Dtz_Magic, entry.dtz);
+        if (entry.has_dtz) dtz_count++;
+        entry_by_key[entry.wdl.key] = entries.size();
+        entry_by_key[entry.wdl.key2] = entries.size();
+        largest_figures = max(largest_figures, entry.wdl.figures);
+        entries.push_back(entry);
+    }
+    closedir(dir);
+    return (int) entries.size() + dtz_count;
+}
+
+int Syzygy::largest() {
+    return largest_figures;
+}
+
+// the value the table stores at index, following the pairs of the Huffman symbol that covers it
+static int decompress(const Pairs &d, uint64_t index) {
+    if (d.flags & Single_Value_Flag) return d.min_length;
+    // the sparse index entry nearest to the index, then block by block to the one that holds it
+    const uint8_t *sparse = d.sparse_index + 6 * (index / d.span);
+    uint32_t block = read32(sparse);
+    int offset = read16(sparse + 4) + (int) (index % d.span) - (int) (d.span / 2);
+    while (offset < 0) offset += read16(d.block_length + 2 * --block) + 1;
+    while (offset > read16(d.block_length + 2 * block)) offset -= read16(d.block_length + 2 * block++) + 1;
+    const uint8_t *code = d.data + (uint64_t) block * d.block_size;
+    uint64_t buffer = (uint64_t) read32_big_endian(code) << 32 | read32_big_endian(code + 4);
+    code += 8;
+    int bits = 64;
+    int symbol;
+    while (true) {
+        int length = 0; // minus min_length
+        while (buffer < d.base[length]) ++length;
+        symbol = (int) ((buffer - d.base[length]) >> (64 - length - d.min_length)) + read16(d.lowest_symbol + 2 * length);
+        if (offset < d.symbol_length[symbol] + 1) break;
+        offset -= d.symbol_length[symbol] + 1;
+        length += d.min_length;
+        buffer <<= length;
+        bits -= length;
+        if (bits <= 32) {
+            bits += 32;
+            buffer |= (uint64_t) read32_big_endian(code) << (64 - bits);
+            code += 4;
+        }
+    }
+    // the symbol stands for symbol_length + 1 values, the pairs it is made of are next to each other
+    while (d.symbol_length[symbol] != 0) {
+        int left = left_symbol(d.tree, symbol);
+        if (offset < d.symbol_length[left] + 1) {
+            symbol = left;
+        } else {
+            offset -= d.symbol_length[left] + 1;
+            symbol = right_symbol(d.tree, symbol);
+        }
+    }
+    return left_symbol(d.tree, symbol);
+}
+
+// dtz values are stored in moves or plies, maybe through a map; the result is in plies
+static int map_dtz(Syzygy_Table &table, int file, int value, int wdl) {
+    static const int Wdl_Map[5] = { 1, 3, 0, 2, 0 };
+    const Pairs &d = table.get(0, file);
+    if (d.flags & Mapped_Flag) {
+        int start = d.map_index[Wdl_Map[wdl + 2]];
+        value = (d.flags & Wide_Flag) ? read16(table.map + 2 * (start + value)) : table.map[start + value];
+    }
+    if ((wdl == Syzygy::Win && !(d.flags & Win_Plies_Flag)) || (wdl == Syzygy::Loss && !(d.flags & Loss_Plies_Flag)) ||
+        wdl == Syzygy::Cursed_Win || wdl == Syzygy::Blessed_Loss) value *= 2;
+    return value + 1;
+}
+
+static inline bool pawns_before(int square1, int square2) {
+    return Map_Pawns[square1] < Map_Pawns[square2];
+}
+
+// the wdl (value - 2) or dtz the table stores for the position; state is set on failure or if the dtz table holds
+// the other side to move. En passant captures are not taken into account.
+static int probe_table(Position &pos, bool dtz, int wdl, int &state) {
+    int counts[2][8] = {};
+    int codes[64];
+    int figures = 0;
+    for (int square = 0; square < 64; ++square) {
+        int figure = pos.chessboard[square];
+        codes[square] = 0;
+        if (figure == 0) continue;
+        figures++;
+        counts[Is_White(figure) ? 0 : 1][figure & Type_Mask]++;
+        codes[square] = Piece_Codes[figure & Type_Mask] | (Is_Black(figure) ? 8 : 0);
+    }
+    if (figures == 2) return Syzygy::Draw;
+    unsigned long long key = signature(counts);
+    auto found = entry_by_key.find(key);
+    if (found == entry_by_key.end() || (dtz && !entries[found->second].has_dtz)) {
+        state = Probe_Fail;
+        return 0;
+    }
+    Syzygy_Table &table = dtz ? entries[found->second].dtz : entries[found->second].wdl;
+    // the tables have the stronger side as white and only white to move for a symmetric material: otherwise swap
+    // the colours and mirror the board top to bottom
+    bool flip = key != table.key || (!pos.white_move && table.key == table.key2);
+    int flip_colour = flip ? 8 : 0;
+    int flip_squares = flip ? 56 : 0;
+    int side = (flip ? 1 : 0) ^ (pos.white_move ? 0 : 1);
+    int squares[Syzygy::Max_Figures];
+    int pieces[Syzygy::Max_Figures];
+    int size = 0;
+    int lead = 0;
+    int file = 0;
+    unsigned long long lead_pawns = 0;
+    if (table.has_pawns) {
+        // the table is split by the file of the leading pawn: the one nearest the edge, then the lowest
+        int pawn = table.get(0, 0).pieces[0] ^ flip_colour;
+        for (int square = 0; square < 64; ++square) {
+            if (codes[square] != pawn) continue;
+            squares[size++] = square ^ flip_squares;
+            lead_pawns |= 1ULL << square;
+        }
+        lead = size;
+        swap(squares[0], *max_element(squares, squares + lead, pawns_before));
+        file = min(squares[0] & 7, 7 - (squares[0] & 7));
+    }
+    if (dtz && (table.get(side, file).flags & Side_Flag) != side && (table.key != table.key2 || table.has_pawns)) {
+        state = Probe_Change_Side;
+        return 0;
+    }
+    for (int square = 0; square < 64; ++square) {
+        if (codes[square] == 0 || (lead_pawns & (1ULL << square))) continue;
+        squares[size] = square ^ flip_squares;
+        pieces[size++] = codes[square] ^ flip_colour;
+    }
+    Pairs &d = table.get(side, file);
+    // the figures in the order of the table
+    for (int i = lead; i < size - 1; ++i) {
+        for (int j = i + 1; j < size; ++j) {
+            if (d.pieces[i] == pieces[j]) {
+                swap(pieces[i], pieces[j]);
+                swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+    if ((squares[0] & 7) > 3) {
+        for (int i = 0; i < size; ++i) squares[i] ^= 7;
+    }
+    uint64_t index;
+    if (table.has_pawns) {
+        index = Lead_Pawn_Index[lead][squares[0]];
+        stable_sort(squares + 1, squares + lead, pawns_before);
+        for (int i = 1; i < lead; ++i) index += Binomial[i][Map_Pawns[squares[i]]];
+    } else {
+        // without pawns the leading figure goes to the a1-d1-d4 triangle and the first of its group off the
+        // diagonal below it
+        if ((squares[0] >> 3) > 3) {
+            for (int i = 0; i < size; ++i) squares[i] ^= 56;
+        }
+        for (int i = 0; i < d.group_length[0]; ++i) {
+            if (off_diagonal(squares[i]) == 0) continue;
+            if (off_diagonal(squares[i]) > 0) {
+                for (int j = i; j < size; ++j) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+        if (table.unique_pieces) {
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (off_diagonal(squares[0]) != 0) {
+                index = ((uint64_t) Map_A1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if (off_diagonal(squares[1]) != 0) {
+                index = (6 * 63 + (squares[0] >> 3) * 28 + Map_B1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if (off_diagonal(squares[2]) != 0) {
+                index = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 + ((squares[1] >> 3) - adjust1) * 28 +
+                        Map_B1H1H7[squares[2]];
+            } else {
+                index = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 +
+                        ((squares[1] >> 3) - adjust1) * 6 + ((squares[2] >> 3) - adjust2);
+            }
+        } else {
+            index = Map_KK[Map_A1D1D4[squares[0]]][squares[1]];
+        }
+    }
+    index *= d.group_index[0];
+    // every further group as a combination of the squares the groups before it leave free
+    int *group = squares + d.group_length[0];
+    bool remaining_pawns = table.has_pawns && table.pawn_count[1] > 0;
+    for (int next = 1; d.group_length[next] != 0; ++next) {
+        sort(group, group + d.group_length[next]);
+        uint64_t combination = 0;
+        for (int i = 0; i < d.group_length[next]; ++i) {
+            int adjust = 0;
+            for (int *square = squares; square < group; ++square) adjust += group[i] > *square;
+            combination += Binomial[i + 1][group[i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = false;
+        index += combination * d.group_index[next];
+        group += d.group_length[next];
+    }
+    if (index >= d.group_index[find(d.group_length, d.group_length + Syzygy::Max_Figures, 0) - d.group_length]) {
+        state = Probe_Fail;
+        return 0;
+    }
+    int value = decompress(d, index);
+    return dtz ? map_dtz(table, file, value, wdl) : value - 2;
+}
+
+static inline int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+static inline bool zeroing_move(Position &pos, const Move &move) {
+    return pos.chessboard[move.to] != 0 || Get_Type(pos.chessboard[move.from]) == Pawn;
+}
+
+static inline bool mated(Position &pos) {
+    int checker_squares[18];
+    return pos.get_checkers(checker_squares) > 0 && pos.count_legal_moves() == 0;
+}
+
+// the dtz of a position whose best move is a zeroing move with the given result
+static inline int dtz_before_zeroing(int wdl) {
+    return wdl == Syzygy::Win ? 1 : wdl == Syzygy::Cursed_Win ? 101 : wdl == Syzygy::Blessed_Loss ? -101 :
+           wdl == Syzygy::Loss ? -1 : 0;
+}
+
+// wdl with the captures (and the pawn moves for dtz) searched: the tables do not know en passant, and a dtz table
+// may hold any value where a zeroing move wins
+static int search(Position &pos, bool check_zeroing, int &state) {
+    vector<Move> moves = pos.get_all_legal_moves();
+    int best = Syzygy::Loss;
+    size_t searched = 0;
+    for (Move move : moves) {
+        bool capture = pos.chessboard[move.to] != 0 ||
+                       (Get_Type(pos.chessboard[move.from]) == Pawn && (move.to - move.from) % 8 != 0);
+        if (!capture && !(check_zeroing && Get_Type(pos.chessboard[move.from]) == Pawn)) continue;
+        searched++;
+        pos.make_move(move);
+        int value = -search(pos, false, state);
+        pos.undo_move(move);
+        if (state == Probe_Fail) return Syzygy::Draw;
+        if (value > best) {
+            best = value;
+            if (value >= Syzygy::Win) {
+                state = Probe_Zeroing;
+                return value;
+            }
+        }
+    }
+    // with every move searched the table is not needed, and may be wrong
+    bool no_more_moves = searched > 0 && searched == moves.size();
+    int value = best;
+    if (!no_more_moves) {
+        value = probe_table(pos, false, 0, state);
+        if (state == Probe_Fail) return Syzygy::Draw;
+    }
+    if (best >= value) {
+        state = best > Syzygy::Draw || no_more_moves ? Probe_Zeroing : Probe_Ok;
+        return best;
+    }
+    state = Probe_Ok;
+    return value;
+}
+
+static int search_dtz(Position &pos, int &state) {
+    state = Probe_Ok;
+    int wdl = search(pos, true, state);
+    if (state == Probe_Fail || wdl == Syzygy::Draw) return 0;
+    if (state == Probe_Zeroing) return dtz_before_zeroing(wdl);
+    int dtz = probe_table(pos, true, wdl, state);
+    if (state == Probe_Fail) return 0;
+    if (state != Probe_Change_Side) {
+        return (dtz + 100 * (wdl == Syzygy::Blessed_Loss || wdl == Syzygy::Cursed_Win)) * sign(wdl);
+    }
+    // the table holds the other side to move: one ply more than the best move
+    int best = 0xFFFF;
+    for (Move move : pos.get_all_legal_moves()) {
+        bool zeroing = zeroing_move(pos, move);
+        pos.make_move(move);
+        dtz = zeroing ? -dtz_before_zeroing(search(pos, false, state)) : -search_dtz(pos, state);
+        if (dtz == 1 && mated(pos)) best = 1;
+        if (!zeroing) dtz += sign(dtz);
+        if (dtz < best && sign(dtz) == sign(wdl)) best = dtz;
+        pos.undo_move(move);
+        if (state == Probe_Fail) return 0;
+    }
+    return best == 0xFFFF ? -1 : best;
+}
+
+// few enough figures and no castling rights
+static bool covered(Position &pos) {
+    if (largest_figures == 0 || pos.get_castling_rights() != 0) return false;
+    int figures = 0;
+    for (int square = 0; square < 64; ++square) {
+        if (pos.chessboard[square] != 0 && ++figures > largest_figures) return false;
+    }
+    return true;
+}
+
+bool Syzygy::probe_wdl(Position &pos, int &wdl) {
+    if (!covered(pos)) return false;
+    Probes.fetch_add(1, memory_order_relaxed);
+    int state = Probe_Ok;
+    wdl = search(pos, false, state);
+    if (state == Probe_Fail) return false;
+    Hits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+bool Syzygy::probe_dtz(Position &pos, int &dtz) {
+    if (!covered(pos)) return false;
+    Probes.fetch_add(1, memory_order_relaxed);
+    int state = Probe_Ok;
+    dtz = search_dtz(pos, state);
+    if (state == Probe_Fail) return false;
+    Hits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+bool Syzygy::root_moves(Position &pos, vector<Move> &moves) {
+    static const int Max_Dtz = 1 << 18;
+    moves.clear();
+    if (!covered(pos)) return false;
+    vector<Move> legal_moves = pos.get_all_legal_moves();
+    if (legal_moves.empty()) return false;
+    int halfmove_clock = pos.halfmove_clock;
+    vector<int> ranks;
+    for (Move move : legal_moves) {
+        int state = Probe_Ok;
+        int dtz;
+        pos.make_move(move);
+        if (pos.halfmove_clock == 0) {
+            dtz = dtz_before_zeroing(-search(pos, false, state));
+        } else if (pos.halfmove_clock >= 100) {
+            dtz = 0;
+        } else {
+            dtz = -search_dtz(pos, state);
+            dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : 0;
+        }
+        if (dtz == 2 && mated(pos)) dtz = 1;
+        pos.undo_move(move);
+        Probes.fetch_add(1, memory_order_relaxed);
+        if (state == Probe_Fail) {
+            moves.clear();
+            return false;
+        }
+        Hits.fetch_add(1, memory_order_relaxed);
+        // wins the fifty-move rule allows rank the same, as do losses it cannot save
+        int rank = dtz > 0 ? (dtz + halfmove_clock <= 99 ? Max_Dtz : Max_Dtz - (dtz + halfmove_clock)) :
+                   dtz < 0 ? (-dtz * 2 + halfmove_clock < 100 ? -Max_Dtz : -Max_Dtz + (-dtz + halfmove_clock)) : 0;
+        move.value = dtz;
+        if (!moves.empty() && rank < ranks[0]) continue;
+        if (!moves.empty() && rank > ranks[0]) {
+            moves.clear();
+            ranks.clear();
+        }
+        moves.push_back(move);
+        ranks.push_back(rank);
+    }
+    stable_sort(moves.begin(), moves.end(), [](const Move &lhs, const Move &rhs) {
+        return lhs.value < rhs.value;
+    });
+    return true;
+}
+
+void Syzygy::reset_statistics() {
+    Probes = 0;
+    Hits = 0;
+}
+
+string Syzygy::statistics() {
+    if (largest_figures == 0) return "no syzygy tables loaded";
+    unsigned long long probes = Probes;
+    unsigned long long hits = Hits;
+    ostringstream line;
+    line << fixed << setprecision(1) << "syzygy tables: " << entries.size() << " wdl and " << dtz_count <<
+         " dtz loaded (up to " << largest_figures << " figures), " << hits << "/" << probes << " probes hit (" <<
+         (probes ? 100.0 * hits / probes : 0.0) << "%), " << (Enabled ? "used" : "not used") << " by the search";
+    return line.str();
+}
@@ -0,0 +1,53 @@
+#include "Position.h"
+#include <string>
+#include <vector>
+#include <atomic>
+
+#ifndef CHESS_SYZYGY_H
+#define CHESS_SYZYGY_H
+
+using namespace std;
+
+// Syzygy endgame tables, mapped read-only with mmap from a directory: KRvKN.rtbw holds win/draw/loss for both sides
+// to move, KRvKN.rtbz the distance to the next zeroing move (capture or pawn move) for one side to move. The files
+// are compressed (canonical Huffman codes of recursive pairs) and index positions by the leading pawns or kings
+// with the symmetries of the board; the decoding follows the published probing code. Positions with castling rights
+// are not covered. Results take the fifty-move rule into account: a cursed win is a win that the rule turns into
+// a draw, a blessed loss a loss it saves.
+class Syzygy {
+public:
+    static const int Loss = -2;
+    static const int Blessed_Loss = -1;
+    static const int Draw = 0;
+    static const int Cursed_Win = 1;
+    static const int Win = 2;
+    static const int Max_Figures = 7;
+    // search score of a won position: below the .etb scores, which know the distance to mate
+    static const int Win_Score = 19000;
+    // search and get_best_move use the tables; off by default until the decoder has been checked against real
+    // tables ('syzygy check', the syzygy test)
+    static bool Enabled;
+
+    // maps every *.rtbw file of the directory and its *.rtbz file if there is one (the previous tables are
+    // released), returns the number of files mapped
+    static int load(const string &directory);
+    static int largest(); // most figures of a loaded table, 0 without tables
+    // win/draw/loss of the position from the side to move's view, false if no table covers it
+    static bool probe_wdl(Position &pos, int &wdl);
+    // plies to the next zeroing move, negative if the side to move loses, 0 for draws, +-1 just before a winning or
+    // losing zeroing move and 101 more for cursed wins and blessed losses; false if no table covers it
+    static bool probe_dtz(Position &pos, int &dtz);
+    // the legal moves with the best result, counting the halfmove clock towards the fifty-move rule, ordered by
+    // dtz: the fastest zeroing move first when winning, the slowest when losing; false unless the tables cover
+    // every move
+    static bool root_moves(Position &pos, vector<Move> &moves);
+
+    static void reset_statistics();
+    static string statistics(); // one line with probes and hits since the last reset
+
+private:
+    static atomic<unsigned long long> Probes;
+    static atomic<unsigned long long> Hits;
+};
+
+#endif //CHESS_SYZYGY_H
@@ -0,0 +1,207 @@
+#include "Tablebase.h"
+#include "Figure.h"
+#include <unordered_map>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const char Tablebase::Magic[8] = { 'C', 'H', 'E', 'S', 'S', 'E', 'T', 'B' };
+atomic<unsigned long long> Tablebase::Probes(0);
+atomic<unsigned long long> Tablebase::Hits(0);
+
+static const int Name_Types[6] = { King, Queen, Rook, Bishop, Knight, Pawn };
+static const string Name_Letters = "KQRBNP";
+
+// tables by material signature, written only by load() while no search runs
+static unordered_map<unsigned long long, Tablebase::Table> tables;
+static int largest_figures = 0;
+
+// 4 bits per (colour, figure type) count, white first
+static inline unsigned long long signature(const int counts[2][8]) {
+    unsigned long long key = 0;
+    for (int colour = 0; colour < 2; ++colour) {
+        for (int type = 0; type < 8; ++type) key = (key << 4) | (unsigned long long) counts[colour][type];
+    }
+    return key;
+}
+
+bool Tablebase::parse_material(const string &material, int codes[], int &figures) {
+    size_t separator = material.find('v');
+    if (separator == string::npos || material.size() - 1 > (size_t) Max_Figures) return false;
+    figures = 0;
+    for (int colour = 0; colour < 2; ++colour) {
+        string side = colour == 0 ? material.substr(0, separator) : material.substr(separator + 1);
+        // exactly one king, first, and the other figures in name order
+        if (side.empty() || side[0] != 'K') return false;
+        size_t last = 0;
+        for (size_t i = 0; i < side.size(); ++i) {
+            size_t piece = Name_Letters.find(side[i]);
+            if (piece == string::npos || (i == 0) != (piece == 0) || piece < last) return false;
+            last = piece;
+            codes[figures++] = (colour == 0 ? White : Black) | Name_Types[piece];
+        }
+    }
+    return true;
+}
+
+unsigned long long Tablebase::positions(int figures) {
+    unsigned long long count = 2 * 32;
+    for (int i = 1; i < figures; ++i) count *= 64;
+    return count;
+}
+
+unsigned long long Tablebase::index(const int squares[], int figures, bool white_move) {
+    int mirror = (squares[0] & 7) > 3 ? 7 : 0;
+    int king = squares[0] ^ mirror;
+    unsigned long long result = (white_move ? 0 : 32) + (king >> 3) * 4 + (king & 7);
+    for (int i = 1; i < figures; ++i) result = result * 64 + (squares[i] ^ mirror);
+    return result;
+}
+
+int Tablebase::load(const string &directory) {
+    for (auto &entry : tables) munmap(entry.second.mapping, entry.second.size);
+    tables.clear();
+    largest_figures = 0;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) return 0;
+    struct dirent *file_entry;
+    while ((file_entry = readdir(dir)) != nullptr) {
+        string name = file_entry->d_name;
+        if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".etb") != 0) continue;
+        Table table;
+        table.material = name.substr(0, name.size() - 4);
+        if (!parse_material(table.material, table.codes, table.figures)) continue;
+        table.positions = positions(table.figures);
+        table.size = sizeof(Header) + (table.positions + 3) / 4 + table.positions;
+        int fd = open((directory + "/" + name).c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size != table.size) {
+            close(fd);
+            continue;
+        }
+        table.mapping = mmap(nullptr, table.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (table.mapping == MAP_FAILED) continue;
+        const Header *header = (const Header *) table.mapping;
+        if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version ||
+            header->figures != (uint32_t) table.figures || header->positions != table.positions ||
+            strncmp(header->material, table.material.c_str(), sizeof(header->material)) != 0) {
+            munmap(table.mapping, table.size);
+            continue;
+        }
+        table.wdl = (const uint8_t *) table.mapping + sizeof(Header);
+        table.dtm = table.wdl + (table.positions + 3) / 4;
+        int counts[2][8] = {};
+        for (int i = 0; i < table.figures; ++i) counts[(table.codes[i] & White) ? 0 : 1][table.codes[i] & Type_Mask]++;
+        tables[signature(counts)] = table;
+        largest_figures = max(largest_figures, table.figures);
+    }
+    closedir(dir);
+    return (int) tables.size();
+}
+
+int Tablebase::largest() {
+    return largest_figures;
+}
+
+// can the side to move take the pawn that just made a two-square move
+static bool en_passant_possible(Position &pos) {
+    if (pos.possible_en_passant < 0 || pos.possible_en_passant >= 64) return false;
+    int pawn = pos.possible_en_passant + (pos.white_move ? -8 : 8);
+    int own_pawn = (pos.white_move ? White : Black) | Pawn;
+    return ((pawn & 7) > 0 && pos.chessboard[pawn - 1] == own_pawn) ||
+           ((pawn & 7) < 7 && pos.chessboard[pawn + 1] == own_pawn);
+}
+
+bool Tablebase::probe(Position &pos, int &wdl, int &dtm) {
+    if (largest_figures == 0 || pos.get_castling_rights() != 0 || en_passant_possible(pos)) return false;
+    int counts[2][8] = {};
+    int squares_by_code[24][Max_Figures];
+    int figures = 0;
+    for (int square = 0; square < 64; ++square) {
+        int figure = pos.chessboard[square];
+        if (figure == 0) continue;
+        if (++figures > largest_figures) return false;
+        int colour = Is_White(figure) ? 0 : 1;
+        squares_by_code[figure][counts[colour][figure & Type_Mask]++] = square;
+    }
+    Probes.fetch_add(1, memory_order_relaxed);
+    if (figures == 2) {
+        wdl = Draw;
+        dtm = 0;
+        Hits.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+    // look the position up as it is, or with the colours swapped and the board mirrored top to bottom
+    bool flip = false;
+    auto found = tables.find(signature(counts));
+    if (found == tables.end()) {
+        int flipped[2][8];
+        memcpy(flipped[0], counts[1], sizeof(flipped[0]));
+        memcpy(flipped[1], counts[0], sizeof(flipped[1]));
+        found = tables.find(signature(flipped));
+        if (found == tables.end()) return false;
+        flip = true;
+    }
+    const Table &table = found->second;
+    int squares[Max_Figures];
+    int used[24] = {};
+    for (int i = 0; i < table.figures; ++i) {
+        int code = flip ? (table.codes[i] ^ (White | Black)) : table.codes[i];
+        squares[i] = squares_by_code[code][used[code]++] ^ (flip ? 56 : 0);
+    }
+    unsigned long long entry = index(squares, table.figures, pos.white_move != flip);
+    wdl = (table.wdl[entry >> 2] >> ((entry & 3) * 2)) & 3;
+    dtm = table.dtm[entry];
+    if (wdl == Illegal) return false;
+    Hits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+bool Tablebase::root_move(Position &pos, Move &move) {
+    if (largest_figures == 0) return false;
+    vector<Move> moves = pos.get_all_legal_moves();
+    if (moves.empty()) return false;
+    int best_score = 0;
+    bool found = false;
+    for (Move candidate : moves) {
+        pos.make_move(candidate);
+        int wdl;
+        int dtm;
+        bool known = probe(pos, wdl, dtm);
+        pos.undo_move(candidate);
+        if (!known) return false;
+        // score from the mover's view: faster wins and slower losses first
+        int score = wdl == Loss ? Win_Score - dtm : (wdl == Win ? -(Win_Score - dtm) : 0);
+        if (!found || score > best_score) {
+            best_score = score;
+            move = candidate;
+            found = true;
+        }
+    }
+    move.value = best_score;
+    return true;
+}
+
+void Tablebase::reset_statistics() {
+    Probes = 0;
+    Hits = 0;
+}
+
+string Tablebase::statistics() {
+    if (largest_figures == 0) return "no endgame tables loaded";
+    unsigned long long probes = Probes;
+    unsigned long long hits = Hits;
+    ostringstream line;
+    line << fixed << setprecision(1) << "endgame tables: " << tables.size() << " loaded (up to " << largest_figures <<
+         " figures), " << hits << "/" << probes << " probes hit (" << (probes ? 100.0 * hits / probes : 0.0) << "%)";
+    return line.str();
+}
@@ -0,0 +1,73 @@
+#include "Position.h"
+#include <string>
+#include <cstdint>
+#include <atomic>
+
+#ifndef CHESS_TABLEBASE_H
+#define CHESS_TABLEBASE_H
+
+using namespace std;
+
+// Endgame tables for positions with few figures, mapped read-only with mmap from a directory and probed by the
+// search. A table covers one material combination, named like KRvKN.etb: white's figures, 'v', black's figures,
+// in the order K Q R B N P. The same table serves the colour-flipped position (board mirrored top to bottom).
+//
+// Table file (little endian):
+//   char magic[8] = "CHESSETB", uint32 version = 1, uint32 figures, char material[16], uint64 positions,
+//   uint8 wdl[(positions + 3) / 4], uint8 dtm[positions]
+// wdl holds 2 bits per position from the side to move's view (Draw, Win, Loss, Illegal), dtm the distance to mate
+// in plies (255 for 255 or more, 0 for draws). Positions with castling rights or a capturable en passant pawn are
+// not covered, and the fifty-move rule is ignored. Index: the side to move, then the white king (on files a-d, the
+// board is mirrored left to right otherwise), then the square of every other figure in the order of the name.
+class Tablebase {
+public:
+    static const int Draw = 0;
+    static const int Win = 1;
+    static const int Loss = 2;
+    static const int Illegal = 3;
+    static const int Max_Figures = 5;
+    static const int Win_Score = 20000; // search score of a won table position: Win_Score - plies to mate
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t figures;
+        char material[16];
+        uint64_t positions;
+    };
+    static const char Magic[8];
+    static const uint32_t Version = 1;
+
+    struct Table {
+        string material;
+        int figures;
+        int codes[Max_Figures]; // figure codes in index order
+        unsigned long long positions;
+        const uint8_t *wdl;
+        const uint8_t *dtm;
+        void *mapping;
+        size_t size;
+    };
+
+    // maps every *.etb file of the directory (the previous tables are released), returns the number of tables
+    static int load(const string &directory);
+    static int largest(); // most figures of a loaded table, 0 without tables
+    // wdl and dtm of the position from the side to move's view, false if no table covers it
+    static bool probe(Position &pos, int &wdl, int &dtm);
+    // the legal move that wins fastest, holds a draw or loses slowest; false unless the tables cover every move
+    static bool root_move(Position &pos, Move &move);
+
+    // "KRvKN" -> figure codes in index order; false for anything that is not a valid name
+    static bool parse_material(const string &material, int codes[], int &figures);
+    static unsigned long long positions(int figures);
+    static unsigned long long index(const int squares[], int figures, bool white_move);
+
+    static void reset_statistics();
+    static string statistics(); // one line with probes and hits since the last reset
+
+private:
+    static atomic<unsigned long long> Probes;
+    static atomic<unsigned long long> Hits;
+};
+
+#endif //CHESS_TABLEBASE_H
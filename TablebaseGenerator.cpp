@@ -0,0 +1,607 @@
+#include "TablebaseGenerator.h"
+#include "Figure.h"
+#include "Syzygy.h"
+#include <omp.h>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+const vector<string> TablebaseGenerator::Default_Materials = {
+        "KQvK", "KRvK", "KBvK", "KNvK", "KPvK",
+        "KQvKR", "KRvKB", "KRvKN", "KBNvK", "KBBvK"
+};
+
+static const int Max_Dtm = 255; // the file has a byte of distance, longer mates are written as 255
+static const int Max_Ply = 0x3FFE; // of the working state: 2 bits of win/draw/loss and 14 of distance
+static const uint16_t Unknown = 0xFFFF;
+
+static inline uint16_t Make_State(int wdl, int dtm) {
+    return (uint16_t) ((wdl << 14) | dtm);
+}
+
+static inline int Get_State_Wdl(uint16_t state) {
+    return state >> 14;
+}
+
+static inline int Get_State_Dtm(uint16_t state) {
+    return state & 0x3FFF;
+}
+
+// what the children of a position are known to be: a child only counts as decided up to a distance of 'limit'
+struct Children {
+    int moves;
+    int fastest_loss; // smallest distance of a child lost for the opponent, -1 if none
+    int slowest_win; // largest distance of a child won for the opponent, -1 if none
+    int draws;
+    int undecided;
+    bool missing; // a capture or promotion led to a table that is not loaded
+};
+
+static bool file_exists(const string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+static string material_name(const int counts[2][8]) {
+    static const int Types[5] = { Queen, Rook, Bishop, Knight, Pawn };
+    static const char Letters[5] = { 'Q', 'R', 'B', 'N', 'P' };
+    string name;
+    for (int colour = 0; colour < 2; ++colour) {
+        if (colour == 1) name += 'v';
+        name += 'K';
+        for (int piece = 0; piece < 5; ++piece) name += string((size_t) counts[colour][Types[piece]], Letters[piece]);
+    }
+    return name;
+}
+
+// a smaller table (or its colour-flipped twin) exists for every capture and promotion out of the material
+static bool dependencies_present(const int codes[], int figures, const string &directory, string &missing) {
+    int counts[2][8] = {};
+    for (int i = 0; i < figures; ++i) counts[(codes[i] & White) ? 0 : 1][codes[i] & Type_Mask]++;
+    vector<string> needed;
+    for (int colour = 0; colour < 2; ++colour) {
+        for (int type : { Queen, Rook, Bishop, Knight, Pawn }) {
+            if (counts[colour][type] == 0) continue;
+            // a capture of this figure, with or without a promotion of one of the capturer's pawns
+            counts[colour][type]--;
+            needed.push_back(material_name(counts));
+            if (counts[1 - colour][Pawn] > 0) {
+                for (int promoted : { Queen, Rook, Bishop, Knight }) {
+                    counts[1 - colour][Pawn]--;
+                    counts[1 - colour][promoted]++;
+                    needed.push_back(material_name(counts));
+                    counts[1 - colour][promoted]--;
+                    counts[1 - colour][Pawn]++;
+                }
+            }
+            counts[colour][type]++;
+        }
+        if (counts[colour][Pawn] > 0) {
+            for (int promoted : { Queen, Rook, Bishop, Knight }) {
+                counts[colour][Pawn]--;
+                counts[colour][promoted]++;
+                needed.push_back(material_name(counts));
+                counts[colour][promoted]--;
+                counts[colour][Pawn]++;
+            }
+        }
+    }
+    for (const string &name : needed) {
+        if (name == "KvK") continue;
+        size_t separator = name.find('v');
+        string flipped = name.substr(separator + 1) + "v" + name.substr(0, separator);
+        if (!file_exists(directory + "/" + name + ".etb") && !file_exists(directory + "/" + flipped + ".etb")) {
+            missing = name;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void decode(unsigned long long index, int figures, int squares[], bool &white_move) {
+    for (int i = figures - 1; i >= 1; --i) {
+        squares[i] = (int) (index % 64);
+        index /= 64;
+    }
+    int king = (int) (index % 32);
+    squares[0] = (king / 4) * 8 + king % 4;
+    white_move = index / 32 == 0;
+}
+
+// puts the figures on the board, false for positions that cannot occur (overlapping figures, pawns on the first
+// or last row, the side not to move in check)
+static bool set_board(Position &board, const Tablebase::Table &table, const int squares[], bool white_move) {
+    memset(board.chessboard, 0, sizeof(board.chessboard));
+    for (int i = 0; i < table.figures; ++i) {
+        int square = squares[i];
+        if (board.chessboard[square] != 0) return false;
+        if (Get_Type(table.codes[i]) == Pawn && (square < 8 || square >= 56)) return false;
+        board.chessboard[square] = table.codes[i];
+        if (table.codes[i] == (White | King)) board.white_king_index = square;
+        else if (table.codes[i] == (Black | King)) board.black_king_index = square;
+    }
+    board.white_move = white_move;
+    board.enemy_king_index = white_move ? board.black_king_index : board.white_king_index;
+    board.possible_en_passant = 128;
+    board.halfmove_clock = 0;
+    return !board.is_hanging(board.enemy_king_index);
+}
+
+// index after the figure on 'from' moved to 'to', squares in table order (a move inside the table keeps the material)
+static unsigned long long moved_index(const int squares[], int figures, int from, int to, bool white_move) {
+    int moved[Tablebase::Max_Figures];
+    for (int i = 0; i < figures; ++i) moved[i] = squares[i] == from ? to : squares[i];
+    return Tablebase::index(moved, figures, white_move);
+}
+
+// same_table = false leaves the moves inside the table undecided; wins_only stops at the first child that is not a
+// decided win for the opponent
+static Children scan_children(Position &board, const Tablebase::Table &table, const int squares[],
+                              const atomic<uint16_t> *state, bool same_table, int limit, bool wins_only) {
+    Children children = { 0, -1, -1, 0, 0, false };
+    vector<Move> moves = board.get_all_pseudolegal_moves();
+    board.filter_legal_moves(moves);
+    children.moves = (int) moves.size();
+    for (Move move : moves) {
+        int figure = board.chessboard[move.from];
+        bool pawn = Get_Type(figure) == Pawn;
+        bool capture = board.chessboard[move.to] != 0 || (pawn && (move.to - move.from) % 8 != 0);
+        bool conversion = capture || (pawn && (move.to < 8 || move.to >= 56));
+        if (!conversion && !same_table) {
+            children.undecided++;
+            continue;
+        }
+        int wdl = Tablebase::Illegal;
+        int dtm = 0;
+        if (capture && table.figures == 3) {
+            wdl = Tablebase::Draw; // only the kings are left
+        } else if (conversion) {
+            board.make_move(move);
+            if (!Tablebase::probe(board, wdl, dtm)) children.missing = true;
+            board.undo_move(move);
+        } else {
+            uint16_t child = state[moved_index(squares, table.figures, move.from, move.to, !board.white_move)].load(
+                    memory_order_relaxed);
+            if (child != Unknown) {
+                wdl = Get_State_Wdl(child);
+                dtm = Get_State_Dtm(child);
+            }
+        }
+        if (wdl == Tablebase::Draw) children.draws++;
+        else if (wdl == Tablebase::Illegal || dtm > limit) children.undecided++;
+        else if (wdl == Tablebase::Loss) {
+            if (children.fastest_loss < 0 || dtm < children.fastest_loss) children.fastest_loss = dtm;
+        } else if (dtm > children.slowest_win) children.slowest_win = dtm;
+        if (wins_only && (children.draws > 0 || children.undecided > 0 || children.fastest_loss >= 0)) break;
+    }
+    return children;
+}
+
+// the decided value of a position at this ply, or Unknown; with loss_only a win is not looked for
+static uint16_t resolve(Position &board, const Tablebase::Table &table, const int squares[],
+                        const atomic<uint16_t> *state, int ply, bool loss_only) {
+    Children children = scan_children(board, table, squares, state, true, ply - 1, loss_only);
+    if (loss_only && children.fastest_loss >= 0) return Unknown;
+    if (children.fastest_loss >= 0) return Make_State(Tablebase::Win, children.fastest_loss + 1);
+    if (children.undecided == 0 && children.draws == 0) return Make_State(Tablebase::Loss, children.slowest_win + 1);
+    return Unknown;
+}
+
+// indexes of the positions the side that just moved came from by a non-capturing, non-promoting move
+static void predecessors(Position &board, const Tablebase::Table &table, const int squares[],
+                         vector<unsigned long long> &result) {
+    result.clear();
+    board.white_move = !board.white_move;
+    board.enemy_king_index = board.white_move ? board.black_king_index : board.white_king_index;
+    // the other figures move back the way they move forward
+    vector<Move> moves = board.get_all_pseudolegal_moves();
+    for (int square = 0; square < 64; ++square) {
+        int figure = board.chessboard[square];
+        if (!board.is_it_your_turn(figure) || Get_Type(figure) != Pawn) continue;
+        int back = board.white_move ? -8 : 8;
+        int start_row = board.white_move ? WP_Start_Row : BP_Start_Row;
+        int row = (square + back) / 8;
+        if (board.chessboard[square + back] != 0 || row == 0 || row == 7) continue;
+        moves.emplace_back(square, square + back);
+        if (row - start_row == (board.white_move ? 1 : -1) && board.chessboard[square + 2 * back] == 0) {
+            moves.emplace_back(square, square + 2 * back);
+        }
+    }
+    for (Move move : moves) {
+        int figure = board.chessboard[move.from];
+        if (board.chessboard[move.to] != 0) continue;
+        if (Get_Type(figure) == Pawn && (move.to - move.from) * (board.white_move ? 1 : -1) > 0) continue;
+        board.chessboard[move.to] = figure;
+        board.chessboard[move.from] = 0;
+        if (figure == (White | King)) board.white_king_index = move.to;
+        if (figure == (Black | King)) board.black_king_index = move.to;
+        board.enemy_king_index = board.white_move ? board.black_king_index : board.white_king_index;
+        if (!board.is_hanging(board.enemy_king_index)) {
+            result.push_back(moved_index(squares, table.figures, move.from, move.to, board.white_move));
+        }
+        board.chessboard[move.from] = figure;
+        board.chessboard[move.to] = 0;
+        if (figure == (White | King)) board.white_king_index = move.from;
+        if (figure == (Black | King)) board.black_king_index = move.from;
+    }
+    board.white_move = !board.white_move;
+    board.enemy_king_index = board.white_move ? board.black_king_index : board.white_king_index;
+}
+
+bool TablebaseGenerator::generate(const string &material, const string &directory) {
+    Tablebase::Table table;
+    if (!Tablebase::parse_material(material, table.codes, table.figures)) {
+        cout << material << ": not a material name like KRvK" << endl;
+        return false;
+    }
+    string missing;
+    if (!dependencies_present(table.codes, table.figures, directory, missing)) {
+        cout << material << ": needs " << missing << ".etb first" << endl;
+        return false;
+    }
+    Tablebase::load(directory);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool network = Nnue::Enabled;
+    Nnue::Enabled = false; // the accumulators of the scratch boards are never read
+    table.material = material;
+    table.positions = Tablebase::positions(table.figures);
+    unsigned long long positions = table.positions;
+    unique_ptr<atomic<uint16_t>[]> state(new atomic<uint16_t>[positions]);
+    int threads = omp_get_max_threads();
+    // seeds[ply]: positions a capture or promotion may decide on that ply; frontier: positions decided on the last ply
+    vector<vector<unsigned long long>> seeds(Max_Dtm + 2);
+    vector<unsigned long long> frontier;
+    size_t peak_lists = 0;
+    atomic<bool> missing_table(false);
+
+    // first pass: legality, mates, stalemates and what the captures and promotions lead to
+    vector<vector<vector<unsigned long long>>> local_seeds(threads, vector<vector<unsigned long long>>(seeds.size()));
+    vector<vector<unsigned long long>> local_frontier(threads);
+#pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        Position board = Position(Position::Start_FEN);
+        board.white_can_castle_k = board.white_can_castle_q = board.black_can_castle_k = board.black_can_castle_q = false;
+        int squares[Tablebase::Max_Figures];
+#pragma omp for schedule(dynamic, 4096)
+        for (unsigned long long index = 0; index < positions; ++index) {
+            bool white_move;
+            decode(index, table.figures, squares, white_move);
+            if (!set_board(board, table, squares, white_move)) {
+                state[index].store(Make_State(Tablebase::Illegal, 0), memory_order_relaxed);
+                continue;
+            }
+            state[index].store(Unknown, memory_order_relaxed);
+            Children children = scan_children(board, table, squares, state.get(), false, Max_Ply, false);
+            if (children.missing) missing_table = true;
+            if (children.moves == 0) {
+                bool check = board.is_threatened(white_move ? board.white_king_index : board.black_king_index);
+                state[index].store(check ? Make_State(Tablebase::Loss, 0) : Make_State(Tablebase::Draw, 0),
+                                   memory_order_relaxed);
+                if (check) local_frontier[thread].push_back(index);
+                continue;
+            }
+            if (children.fastest_loss >= 0) {
+                local_seeds[thread][children.fastest_loss + 1].push_back(index);
+            } else if (children.draws == 0 && children.slowest_win >= 0) {
+                local_seeds[thread][children.slowest_win + 1].push_back(index);
+            }
+        }
+    }
+    for (int thread = 0; thread < threads; ++thread) {
+        frontier.insert(frontier.end(), local_frontier[thread].begin(), local_frontier[thread].end());
+        for (size_t ply = 0; ply < seeds.size(); ++ply) {
+            seeds[ply].insert(seeds[ply].end(), local_seeds[thread][ply].begin(), local_seeds[thread][ply].end());
+        }
+    }
+    local_seeds.clear();
+    for (auto &ply_seeds : seeds) peak_lists += ply_seeds.size();
+
+    // then ply by ply from the positions decided on the last one, until nothing is left to decide: the distances
+    // are only cut to a byte when the table is written
+    int ply = 1;
+    int longest = 0;
+    bool too_long = false;
+    for (; !missing_table; ++ply) {
+        bool seeds_left = false;
+        for (size_t later = (size_t) ply; later < seeds.size(); ++later) seeds_left = seeds_left || !seeds[later].empty();
+        if (frontier.empty() && !seeds_left) break;
+        if (ply > Max_Ply) {
+            too_long = true;
+            break;
+        }
+        for (auto &list : local_frontier) list.clear();
+        long long int count = (long long int) frontier.size();
+        long long int seed_count = (size_t) ply < seeds.size() ? (long long int) seeds[ply].size() : 0;
+#pragma omp parallel
+        {
+            int thread = omp_get_thread_num();
+            Position board = Position(Position::Start_FEN);
+            board.white_can_castle_k = board.white_can_castle_q = board.black_can_castle_k = board.black_can_castle_q = false;
+            int squares[Tablebase::Max_Figures];
+            vector<unsigned long long> previous;
+            // a predecessor of a loss is won on this ply, one of a win needs all its moves checked (seeds need both)
+            auto decide = [&](unsigned long long index, bool after_loss, bool loss_only) {
+                if (state[index].load(memory_order_relaxed) != Unknown) return;
+                uint16_t value = Make_State(Tablebase::Win, ply);
+                if (!after_loss) {
+                    bool white_move;
+                    decode(index, table.figures, squares, white_move);
+                    set_board(board, table, squares, white_move);
+                    value = resolve(board, table, squares, state.get(), ply, loss_only);
+                }
+                uint16_t expected = Unknown;
+                if (value != Unknown && state[index].compare_exchange_strong(expected, value)) {
+                    local_frontier[thread].push_back(index);
+                }
+            };
+#pragma omp for schedule(dynamic, 1024) nowait
+            for (long long int i = 0; i < count; ++i) {
+                bool white_move;
+                decode(frontier[i], table.figures, squares, white_move);
+                set_board(board, table, squares, white_move);
+                bool after_loss = Get_State_Wdl(state[frontier[i]].load(memory_order_relaxed)) == Tablebase::Loss;
+                predecessors(board, table, squares, previous);
+                for (unsigned long long index : previous) decide(index, after_loss, true);
+            }
+#pragma omp for schedule(dynamic, 1024)
+            for (long long int i = 0; i < seed_count; ++i) decide(seeds[ply][i], false, false);
+        }
+        frontier.clear();
+        for (auto &list : local_frontier) frontier.insert(frontier.end(), list.begin(), list.end());
+        if ((size_t) ply < seeds.size()) vector<unsigned long long>().swap(seeds[ply]);
+        if (!frontier.empty()) longest = ply;
+        size_t lists = frontier.size();
+        for (auto &ply_seeds : seeds) lists += ply_seeds.size();
+        peak_lists = max(peak_lists, lists);
+    }
+    Nnue::Enabled = network;
+    Tablebase::reset_statistics();
+    if (missing_table) {
+        cout << material << ": a capture or promotion led to a table that could not be probed" << endl;
+        return false;
+    }
+    if (too_long) {
+        cout << material << ": mates longer than " << Max_Ply << " plies" << endl;
+        return false;
+    }
+
+    // pack: 2 bits of win/draw/loss per position, the undecided ones are draws (no mate was found for them on any
+    // ply), then a byte of distance
+    size_t wdl_bytes = (size_t) ((positions + 3) / 4);
+    vector<uint8_t> packed(wdl_bytes + positions, 0);
+    long long int wins = 0;
+    long long int losses = 0;
+    long long int draws = 0;
+    for (unsigned long long index = 0; index < positions; ++index) {
+        uint16_t value = state[index].load(memory_order_relaxed);
+        int wdl = value == Unknown ? Tablebase::Draw : Get_State_Wdl(value);
+        int dtm = value == Unknown || wdl == Tablebase::Illegal ? 0 : min(Get_State_Dtm(value), Max_Dtm);
+        if (wdl == Tablebase::Win) wins++;
+        else if (wdl == Tablebase::Loss) losses++;
+        else if (wdl == Tablebase::Draw) draws++;
+        packed[index >> 2] |= (uint8_t) (wdl << ((index & 3) * 2));
+        packed[wdl_bytes + index] = (uint8_t) dtm;
+    }
+    Tablebase::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Tablebase::Magic, sizeof(header.magic));
+    header.version = Tablebase::Version;
+    header.figures = (uint32_t) table.figures;
+    strncpy(header.material, material.c_str(), sizeof(header.material) - 1);
+    header.positions = positions;
+    string path = directory + "/" + material + ".etb";
+    string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    bool written = file != nullptr && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(packed.data(), 1, packed.size(), file) == packed.size();
+    if (file != nullptr) written = fclose(file) == 0 && written;
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        cout << material << ": could not write " << path << endl;
+        remove(temporary.c_str());
+        return false;
+    }
+    Tablebase::load(directory);
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    size_t working = positions * sizeof(atomic<uint16_t>) + peak_lists * sizeof(unsigned long long) + packed.size();
+    cout << material << ": " << wins << " wins, " << draws << " draws, " << losses << " losses (side to move), " <<
+         "longest mate " << longest << " plies, " << seconds << " seconds, " << working / (1024 * 1024) <<
+         " MB working memory (" << usage.ru_maxrss / 1024 << " MB peak resident), " << (sizeof(header) + packed.size()) /
+         1024 << " KB file" << endl;
+    return true;
+}
+
+int TablebaseGenerator::generate_all(const vector<string> &materials, const string &directory) {
+    int written = 0;
+    for (const string &material : materials) {
+        if (file_exists(directory + "/" + material + ".etb")) {
+            cout << material << ": exists" << endl;
+            continue;
+        }
+        if (!generate(material, directory)) break;
+        written++;
+    }
+    return written;
+}
+
+bool TablebaseGenerator::verify(const string &material, const string &directory) {
+    Tablebase::Table table;
+    if (!Tablebase::parse_material(material, table.codes, table.figures)) {
+        cout << material << ": not a material name like KRvK" << endl;
+        return false;
+    }
+    if (!file_exists(directory + "/" + material + ".etb")) {
+        cout << material << ": no " << directory << "/" << material << ".etb" << endl;
+        return false;
+    }
+    Tablebase::load(directory);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool network = Nnue::Enabled;
+    Nnue::Enabled = false;
+    unsigned long long positions = Tablebase::positions(table.figures);
+    atomic<long long int> checked(0);
+    atomic<long long int> wrong(0);
+    atomic<long long int> missing(0);
+    mutex report_mutex;
+#pragma omp parallel
+    {
+        Position board = Position(Position::Start_FEN);
+        board.white_can_castle_k = board.white_can_castle_q = board.black_can_castle_k = board.black_can_castle_q = false;
+        int squares[Tablebase::Max_Figures];
+#pragma omp for schedule(dynamic, 4096)
+        for (unsigned long long index = 0; index < positions; ++index) {
+            bool white_move;
+            decode(index, table.figures, squares, white_move);
+            if (!set_board(board, table, squares, white_move)) continue;
+            int wdl;
+            int dtm;
+            if (!Tablebase::probe(board, wdl, dtm)) {
+                missing++;
+                continue;
+            }
+            // the value one ply of search over the probed children gives, with the distances cut to a byte as well
+            int expected_wdl = Tablebase::Draw;
+            int expected_dtm = 0;
+            vector<Move> moves = board.get_all_pseudolegal_moves();
+            board.filter_legal_moves(moves);
+            if (moves.empty()) {
+                if (board.is_threatened(white_move ? board.white_king_index : board.black_king_index)) {
+                    expected_wdl = Tablebase::Loss;
+                }
+            } else {
+                int fastest_loss = -1;
+                int slowest_win = -1;
+                bool draw = false;
+                bool probed = true;
+                for (Move move : moves) {
+                    bool capture = board.chessboard[move.to] != 0 ||
+                                   (Get_Type(board.chessboard[move.from]) == Pawn && (move.to - move.from) % 8 != 0);
+                    int child_wdl = Tablebase::Draw;
+                    int child_dtm = 0;
+                    if (!(capture && table.figures == 3)) { // only the kings left is a draw
+                        board.make_move(move);
+                        probed = Tablebase::probe(board, child_wdl, child_dtm);
+                        board.undo_move(move);
+                        if (!probed) break;
+                    }
+                    if (child_wdl == Tablebase::Loss) {
+                        if (fastest_loss < 0 || child_dtm < fastest_loss) fastest_loss = child_dtm;
+                    } else if (child_wdl == Tablebase::Win) {
+                        slowest_win = max(slowest_win, child_dtm);
+                    } else draw = true;
+                }
+                if (!probed) {
+                    missing++;
+                    continue;
+                }
+                if (fastest_loss >= 0) {
+                    expected_wdl = Tablebase::Win;
+                    expected_dtm = min(fastest_loss + 1, Max_Dtm);
+                } else if (!draw) {
+                    expected_wdl = Tablebase::Loss;
+                    expected_dtm = min(slowest_win + 1, Max_Dtm);
+                }
+            }
+            checked++;
+            if (wdl != expected_wdl || dtm != expected_dtm) {
+                if (wrong++ < 10) {
+                    lock_guard<mutex> lock(report_mutex);
+                    cout << board.to_fen() << ": table " << wdl << "/" << dtm << ", children give " << expected_wdl <<
+                         "/" << expected_dtm << " (wdl 0 draw, 1 win, 2 loss / plies)" << endl;
+                }
+            }
+        }
+    }
+    Nnue::Enabled = network;
+    Tablebase::reset_statistics();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+    cout << material << ": " << checked << " positions checked, " << wrong << " differ from their children, " <<
+         missing << " could not be probed, " << seconds << " seconds" << endl;
+    return wrong == 0 && missing == 0;
+}
+
+bool TablebaseGenerator::compare_syzygy(const string &material, const string &directory) {
+    Tablebase::Table table;
+    if (!Tablebase::parse_material(material, table.codes, table.figures)) {
+        cout << material << ": not a material name like KRvK" << endl;
+        return false;
+    }
+    int black_figures = 0;
+    bool pawns = false;
+    for (int i = 0; i < table.figures; ++i) {
+        if (Is_Black(table.codes[i])) black_figures++;
+        if (Get_Type(table.codes[i]) == Pawn) pawns = true;
+    }
+    if (black_figures != 1 || pawns) {
+        cout << material << ": only figures without pawns against a bare king can be compared" << endl;
+        return false;
+    }
+    if (!file_exists(directory + "/" + material + ".etb")) {
+        cout << material << ": no " << directory << "/" << material << ".etb" << endl;
+        return false;
+    }
+    Tablebase::load(directory);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    unsigned long long positions = Tablebase::positions(table.figures);
+    atomic<long long int> checked(0);
+    atomic<long long int> wrong(0);
+    atomic<long long int> missing(0);
+    mutex report_mutex;
+#pragma omp parallel
+    {
+        Position board = Position(Position::Start_FEN);
+        board.white_can_castle_k = board.white_can_castle_q = board.black_can_castle_k = board.black_can_castle_q = false;
+        int squares[Tablebase::Max_Figures];
+#pragma omp for schedule(dynamic, 4096)
+        for (unsigned long long index = 0; index < positions; ++index) {
+            bool white_move;
+            decode(index, table.figures, squares, white_move);
+            if (!set_board(board, table, squares, white_move)) continue;
+            // mated and stalemated positions are left to the search, the tables do not answer for them
+            vector<Move> moves = board.get_all_pseudolegal_moves();
+            board.filter_legal_moves(moves);
+            if (moves.empty()) continue;
+            int wdl;
+            int dtm;
+            int syzygy_wdl;
+            int dtz;
+            if (!Tablebase::probe(board, wdl, dtm) || !Syzygy::probe_wdl(board, syzygy_wdl) ||
+                !Syzygy::probe_dtz(board, dtz)) {
+                missing++;
+                continue;
+            }
+            int expected_wdl = Syzygy::Draw;
+            if (wdl == Tablebase::Win) expected_wdl = dtm > 100 ? Syzygy::Cursed_Win : Syzygy::Win;
+            else if (wdl == Tablebase::Loss) expected_wdl = dtm > 100 ? Syzygy::Blessed_Loss : Syzygy::Loss;
+            int distance = abs(dtz) > 100 ? abs(dtz) - 100 : abs(dtz);
+            checked++;
+            if (syzygy_wdl != expected_wdl || (dtz < 0) != (wdl == Tablebase::Loss) ||
+                (wdl == Tablebase::Draw ? dtz != 0 : distance != dtm && distance != dtm + 1)) {
+                if (wrong++ < 10) {
+                    lock_guard<mutex> lock(report_mutex);
+                    cout << board.to_fen() << ": syzygy " << syzygy_wdl << "/" << dtz << ", table " << wdl << "/" <<
+                         dtm << " (syzygy wdl -2 loss .. 2 win / dtz, table wdl 0 draw, 1 win, 2 loss / plies)" << endl;
+                }
+            }
+        }
+    }
+    Tablebase::reset_statistics();
+    Syzygy::reset_statistics();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+    cout << material << ": " << checked << " positions checked, " << wrong << " differ from the syzygy tables, " <<
+         missing << " could not be probed, " << seconds << " seconds" << endl;
+    return wrong == 0 && missing == 0;
+}
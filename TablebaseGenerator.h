@@ -0,0 +1,32 @@
+#include "Tablebase.h"
+#include <string>
+#include <vector>
+
+#ifndef CHESS_TABLEBASEGENERATOR_H
+#define CHESS_TABLEBASEGENERATOR_H
+
+using namespace std;
+
+// Builds the endgame tables Tablebase probes, by retrograde analysis. A first pass over every index finds the mates
+// and stalemates and looks up captures and promotions in the smaller tables (which must exist already). Then ply by
+// ply, the positions decided on the last ply are moved back (un-moves: the side that just moved takes a non-capturing
+// move back): a predecessor of a loss is a win, a predecessor of a win is checked whether all its moves now lose.
+// Each ply runs over its positions in parallel, the working state is one atomic 16-bit word per position.
+// Whatever is left undecided at the end is a draw. Distances are exact while generating and cut to 255 in the file.
+class TablebaseGenerator {
+public:
+    static const vector<string> Default_Materials; // all 3-figure tables and a selection of 4-figure ones, in order
+    // writes <directory>/<material>.etb and maps it; false if a smaller table it needs is missing
+    static bool generate(const string &material, const string &directory);
+    // generates the tables that do not exist yet, returns the number written
+    static int generate_all(const vector<string> &materials, const string &directory);
+    // checks every position of <directory>/<material>.etb against one ply of search over the probed children;
+    // false if any differs or a child cannot be probed
+    static bool verify(const string &material, const string &directory);
+    // checks every position of <directory>/<material>.etb against the mapped Syzygy tables; for a bare king against
+    // figures without pawns the winning side has no zeroing move but mate, so the dtz of a decided position is its
+    // distance to mate (one more where the file stores moves). False if any differs or cannot be probed
+    static bool compare_syzygy(const string &material, const string &directory);
+};
+
+#endif //CHESS_TABLEBASEGENERATOR_H
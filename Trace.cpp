@@ -0,0 +1,130 @@
+#include "Trace.h"
+#include <omp.h>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+
+using namespace std;
+
+struct Trace_Ring {
+    int omp_thread;
+    atomic<long long int> head; // number of events ever written, only the owning thread writes
+    Trace::Event events[Trace::Ring_Size];
+};
+
+atomic<bool> Trace::enabled(false);
+
+static Trace_Ring *rings[Trace::Max_Threads];
+static atomic<int> ring_count(0);
+static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+static thread_local Trace_Ring *local_ring = nullptr;
+
+static void copy_detail(char *target, const char *source) {
+    strncpy(target, source, Trace::Detail_Length - 1);
+    target[Trace::Detail_Length - 1] = '\0';
+}
+
+long long int Trace::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char *name, char phase, long long int begin, long long int duration, const char *detail) {
+    if (local_ring == nullptr) {
+        int slot = ring_count.fetch_add(1);
+        if (slot >= Max_Threads) return; // should never happen, and losing events beats crashing
+        local_ring = new Trace_Ring();
+        local_ring->omp_thread = omp_get_thread_num();
+        local_ring->head.store(0);
+        rings[slot] = local_ring;
+    }
+    long long int head = local_ring->head.load(memory_order_relaxed);
+    Event &event = local_ring->events[head & (Ring_Size - 1)];
+    event.name = name;
+    event.phase = phase;
+    event.begin = begin;
+    event.duration = duration;
+    copy_detail(event.detail, detail);
+    local_ring->head.store(head + 1, memory_order_release);
+}
+
+Trace::Span::Span(const char *name, const char *label, long long int value) : name(name), begin(-1) {
+    if (!enabled.load(memory_order_relaxed)) return;
+    begin = now();
+    if (*label == '\0') detail[0] = '\0';
+    else snprintf(detail, Detail_Length, "%s %lld", label, value);
+}
+
+Trace::Span::Span(const char *name, Move move) : name(name), begin(-1) {
+    if (!enabled.load(memory_order_relaxed)) return;
+    begin = now();
+    static const char *Promotions[4] = { "", "n", "b", "r" };
+    snprintf(detail, Detail_Length, "%c%d%c%d%s", 'a' + (move.from & 7), (move.from >> 3) + 1, 'a' + (move.to & 7),
+             (move.to >> 3) + 1, Promotions[move.get_promotion_type() & 3]);
+}
+
+Trace::Span::~Span() {
+    if (begin < 0) return;
+    record(name, 'X', begin, now() - begin, detail);
+}
+
+void Trace::instant(const char *name, const char *label, double seconds) {
+    if (!enabled.load(memory_order_relaxed)) return;
+    char detail[Detail_Length];
+    snprintf(detail, Detail_Length, "%s %gs", label, seconds);
+    record(name, 'i', now(), 0, detail);
+}
+
+void Trace::start() {
+    // called between commands, when no traced thread is running
+    int count = min(ring_count.load(), Max_Threads);
+    for (int i = 0; i < count; ++i) if (rings[i] != nullptr) rings[i]->head.store(0);
+    epoch = std::chrono::steady_clock::now();
+    enabled.store(true);
+}
+
+static void write_string(ofstream &out, const char *s) {
+    out << '"';
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+bool Trace::stop(const string &filename) {
+    enabled.store(false);
+    ofstream out(filename);
+    if (!out) return false;
+    out << "{\"traceEvents\":[" << endl;
+    bool first = true;
+    int count = min(ring_count.load(), Max_Threads);
+    out << fixed << setprecision(3);
+    for (int t = 0; t < count; ++t) {
+        Trace_Ring *ring = rings[t];
+        if (ring == nullptr) continue;
+        long long int head = ring->head.load(memory_order_acquire);
+        if (head == 0) continue;
+        out << (first ? "" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << t <<
+            R"(,"args":{"name":"omp thread )" << ring->omp_thread << "\"}}";
+        first = false;
+        for (long long int i = max(0LL, head - Ring_Size); i < head; ++i) {
+            const Event &event = ring->events[i & (Ring_Size - 1)];
+            out << ",\n{\"name\":";
+            write_string(out, event.name);
+            out << ",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << t << ",\"ts\":" << event.begin / 1000.0;
+            if (event.phase == 'X') out << ",\"dur\":" << event.duration / 1000.0;
+            else out << ",\"s\":\"t\"";
+            if (event.detail[0] != '\0') {
+                out << ",\"args\":{\"detail\":";
+                write_string(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+        }
+    }
+    out << endl << "]}" << endl;
+    return true;
+}
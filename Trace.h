@@ -0,0 +1,50 @@
+#include "Move.h"
+#include <string>
+#include <atomic>
+
+#ifndef CHESS_TRACE_H
+#define CHESS_TRACE_H
+
+using namespace std;
+
+// Trace recorder for Chrome/Perfetto (chrome://tracing, ui.perfetto.dev). Every thread appends to its own
+// fixed-size ring buffer without locks, so recording barely changes timing; the buffers are only read when
+// the trace is written, after the traced work has finished. When a ring is full the oldest events are dropped.
+class Trace {
+public:
+    static const int Ring_Size = 1 << 16; // events per thread
+    static const int Max_Threads = 256;
+    static const int Detail_Length = 24;
+
+    struct Event {
+        const char *name;
+        char phase; // 'X' = complete span, 'i' = instant
+        long long int begin; // nanoseconds since start()
+        long long int duration;
+        char detail[Detail_Length];
+    };
+
+    // the details are only put together while recording, so a span costs a load and a branch when it is off
+    class Span {
+    public:
+        explicit Span(const char *name) : Span(name, "", 0) {};
+        Span(const char *name, const char *label, long long int value); // detail "<label> <value>"
+        Span(const char *name, Move move); // detail the move in letters, like Move::to_letter_string
+        ~Span();
+    private:
+        const char *name;
+        long long int begin;
+        char detail[Detail_Length];
+    };
+
+    static atomic<bool> enabled;
+    static void start();
+    static bool stop(const string &filename); // stops recording and writes the JSON file
+    static void instant(const char *name, const char *label, double seconds); // detail "<label> <seconds>s"
+
+private:
+    static long long int now();
+    static void record(const char *name, char phase, long long int begin, long long int duration, const char *detail);
+};
+
+#endif //CHESS_TRACE_H
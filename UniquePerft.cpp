@@ -0,0 +1,229 @@
+#include "UniquePerft.h"
+#include "Zobrist.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include <omp.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// open addressing set of 64 bit keys, 0 marks an empty slot
+class Key_Set {
+public:
+    explicit Key_Set(size_t megabytes) {
+        capacity = 1024;
+        while (capacity * 2 * sizeof(atomic<unsigned long long>) <= megabytes * 1024 * 1024) capacity *= 2;
+        slots.reset(new atomic<unsigned long long>[capacity]);
+        long long int count = (long long int) capacity;
+#pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < count; ++i) slots[i].store(0, memory_order_relaxed);
+        limit = capacity / 4 * 3;
+    }
+
+    // true if the key was not in the set yet
+    inline bool insert(unsigned long long key) {
+        if (key == 0) key = 1;
+        size_t index = key & (capacity - 1);
+        while (true) {
+            unsigned long long current = slots[index].load(memory_order_relaxed);
+            if (current == key) return false;
+            if (current == 0) {
+                if (slots[index].compare_exchange_strong(current, key, memory_order_relaxed)) return true;
+                if (current == key) return false;
+            }
+            index = (index + 1) & (capacity - 1);
+        }
+    }
+
+    // inserts are counted in batches, the set is full once 3/4 of the slots are used (probing gets slow beyond)
+    inline bool add_used(size_t inserted) {
+        return used.fetch_add(inserted, memory_order_relaxed) + inserted > limit;
+    }
+
+private:
+    unique_ptr<atomic<unsigned long long>[]> slots;
+    size_t capacity;
+    size_t limit;
+    atomic<size_t> used{0};
+};
+
+// bucket files of the last ply, written by all threads through their own buffers
+class Key_Spill {
+public:
+    explicit Key_Spill(const string &directory) : directory(directory), files(UniquePerft::Spill_Buckets, nullptr),
+                                                  file_mutexes(UniquePerft::Spill_Buckets) {};
+    ~Key_Spill() {
+        for (FILE *file : files) if (file != nullptr) fclose(file);
+    }
+
+    string bucket_path(int bucket) {
+        return directory + "/unique_" + to_string(bucket) + ".bin";
+    }
+
+    bool open() {
+        for (int bucket = 0; bucket < UniquePerft::Spill_Buckets; ++bucket) {
+            files[bucket] = fopen(bucket_path(bucket).c_str(), "wb");
+            if (files[bucket] == nullptr) return false;
+        }
+        return true;
+    }
+
+    // empties a thread's buffer into the bucket files, grouped by the top 8 bits of the key
+    bool flush(vector<unsigned long long> &buffer) {
+        sort(buffer.begin(), buffer.end());
+        bool ok = true;
+        size_t begin = 0;
+        while (begin < buffer.size()) {
+            int bucket = (int) (buffer[begin] >> 56);
+            size_t end = begin;
+            while (end < buffer.size() && (int) (buffer[end] >> 56) == bucket) end++;
+            lock_guard<mutex> lock(file_mutexes[bucket]);
+            if (fwrite(&buffer[begin], sizeof(unsigned long long), end - begin, files[bucket]) != end - begin) ok = false;
+            begin = end;
+        }
+        buffer.clear();
+        return ok;
+    }
+
+    // distinct keys over all buckets, each bucket is read, sorted and deleted on its own
+    long long int count() {
+        for (FILE *&file : files) {
+            fclose(file);
+            file = nullptr;
+        }
+        long long int distinct = 0;
+        bool ok = true;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : distinct)
+        for (int bucket = 0; bucket < UniquePerft::Spill_Buckets; ++bucket) {
+            string path = bucket_path(bucket);
+            FILE *file = fopen(path.c_str(), "rb");
+            if (file == nullptr) {
+                ok = false;
+                continue;
+            }
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            vector<unsigned long long> keys((size_t) size / sizeof(unsigned long long));
+            if (fread(keys.data(), sizeof(unsigned long long), keys.size(), file) != keys.size()) ok = false;
+            fclose(file);
+            remove(path.c_str());
+            sort(keys.begin(), keys.end());
+            distinct += (long long int) (unique(keys.begin(), keys.end()) - keys.begin());
+        }
+        return ok ? distinct : -1;
+    }
+
+private:
+    string directory;
+    vector<FILE *> files;
+    vector<mutex> file_mutexes;
+};
+
+struct Walk_State {
+    Key_Set &set;
+    Key_Spill *spill; // nullptr: the last ply goes into the set as well
+    int depth;
+    atomic<bool> &failed;
+    vector<long long int> counts; // new positions per ply found by this thread
+    size_t pending = 0; // inserts not yet added to the set's fill count
+    vector<unsigned long long> buffer;
+};
+
+static const size_t Spill_Buffer_Size = 1 << 16;
+
+// the en passant square only makes a different position if the side to move can legally take on it
+static unsigned long long unique_key(Position &pos) {
+    int ep = pos.possible_en_passant;
+    if (ep >= 64) return pos.hash;
+    int pawn = pos.white_move ? (White | Pawn) : (Black | Pawn);
+    int pushed = pos.white_move ? ep - 8 : ep + 8; // square of the double-pushed pawn
+    bool capturable = (ep % 8 > 0 && pos.chessboard[pushed - 1] == pawn) ||
+                      (ep % 8 < 7 && pos.chessboard[pushed + 1] == pawn);
+    if (capturable) {
+        // rare enough to check properly: the capture may be illegal because the pawn is pinned
+        capturable = false;
+        for (Move move : pos.get_all_legal_moves()) if (move.is_en_passant()) capturable = true;
+    }
+    return capturable ? pos.hash : pos.hash ^ Zobrist::Get_En_Passant_Key(ep);
+}
+
+// keeps the plies apart in one set
+static inline unsigned long long ply_salt(int ply) {
+    unsigned long long z = (unsigned long long) (ply + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// records the position reached after ply plies, false if it was seen before (or the walk has to stop)
+static bool visit(Position &pos, int ply, Walk_State &state) {
+    if (ply == state.depth && state.spill != nullptr) {
+        state.buffer.push_back(unique_key(pos));
+        if (state.buffer.size() == Spill_Buffer_Size && !state.spill->flush(state.buffer)) state.failed = true;
+        return false;
+    }
+    if (!state.set.insert(unique_key(pos) ^ ply_salt(ply))) return false;
+    state.counts[ply]++;
+    if (++state.pending == 4096) {
+        if (state.set.add_used(state.pending)) state.failed = true;
+        state.pending = 0;
+    }
+    return !state.failed;
+}
+
+static void walk(Position &pos, int ply, Walk_State &state) {
+    if (ply == state.depth || state.failed) return;
+    vector<Move> moves = pos.get_all_pseudolegal_moves();
+    pos.filter_legal_moves(moves);
+    for (Move move : moves) {
+        pos.make_move(move);
+        if (visit(pos, ply + 1, state)) walk(pos, ply + 1, state);
+        pos.undo_move(move);
+    }
+}
+
+bool UniquePerft::run(Position &root, int depth, size_t megabytes, const string &spill_dir, vector<long long int> &counts) {
+    counts.assign(depth + 1, 0);
+    counts[0] = 1;
+    if (depth <= 0) return true;
+    Key_Set set(megabytes);
+    unique_ptr<Key_Spill> spill;
+    if (!spill_dir.empty()) {
+        spill.reset(new Key_Spill(spill_dir));
+        if (!spill->open()) {
+            cerr << "could not create spill files in " << spill_dir << endl;
+            return false;
+        }
+    }
+    atomic<bool> failed{false};
+    vector<Move> legal_moves = root.get_all_legal_moves();
+    int move_count = (int) legal_moves.size();
+#pragma omp parallel num_threads(omp_get_max_threads())
+    {
+        PerfCounters::Thread_Scope perf_scope;
+        Walk_State state{set, spill.get(), depth, failed, vector<long long int>(depth + 1, 0)};
+#pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < move_count; ++i) {
+            Trace::Span span("root move", legal_moves[i]);
+            Position p = root.copy();
+            p.make_move(legal_moves[i]);
+            if (visit(p, 1, state)) walk(p, 1, state);
+        }
+        if (spill && !state.buffer.empty() && !spill->flush(state.buffer)) failed = true;
+#pragma omp critical
+        for (int ply = 1; ply <= depth; ++ply) counts[ply] += state.counts[ply];
+    }
+    if (spill) {
+        Trace::Span span("count spilled keys");
+        long long int distinct = spill->count();
+        if (distinct < 0) failed = true;
+        counts[depth] = distinct;
+    }
+    return !failed;
+}
@@ -0,0 +1,23 @@
+#include "Position.h"
+#include <string>
+#include <vector>
+
+#ifndef CHESS_UNIQUEPERFT_H
+#define CHESS_UNIQUEPERFT_H
+
+using namespace std;
+
+// Counts distinct positions (rather than move paths) after every ply. The tree is walked from the root moves in
+// parallel and every position is inserted into a lock-free set of Zobrist keys per ply; a position seen before
+// on the same ply is not expanded again, since its subtree is the same. The en passant square only counts when
+// the en passant capture is legal. With a spill directory the last ply, which holds most of the
+// positions, is written to bucket files instead and counted bucket by bucket after the walk.
+class UniquePerft {
+public:
+    static const int Default_Memory_MB = 256;
+    static const int Spill_Buckets = 256;
+    // counts receives the distinct positions per ply (counts[0] = 1), false if the key set ran full
+    static bool run(Position &root, int depth, size_t megabytes, const string &spill_dir, vector<long long int> &counts);
+};
+
+#endif //CHESS_UNIQUEPERFT_H
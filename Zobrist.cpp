@@ -0,0 +1,40 @@
+#include "Zobrist.h"
+
+unsigned long long Zobrist::Pieces[24][64];
+unsigned long long Zobrist::Pawns[24][64];
+unsigned long long Zobrist::Castling[16];
+unsigned long long Zobrist::En_Passant[8];
+unsigned long long Zobrist::Black_To_Move;
+
+// splitmix64 with a fixed seed, so keys (and therefore hash table contents) are the same in every run
+static unsigned long long next_random(unsigned long long &state) {
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static bool init_keys() {
+    unsigned long long state = 0x43686573734B6579ULL;
+    for (auto &figure : Zobrist::Pieces) {
+        for (unsigned long long &key : figure) key = next_random(state);
+    }
+    // empty squares hash to nothing, so a quiet move can XOR the (empty) target square like a capture
+    for (unsigned long long &key : Zobrist::Pieces[0]) key = 0;
+    for (int figure = 0; figure < 24; ++figure) {
+        for (int i = 0; i < 64; ++i) Zobrist::Pawns[figure][i] = (figure & 7) == 2 ? Zobrist::Pieces[figure][i] : 0;
+    }
+    Zobrist::Castling[0] = 0;
+    unsigned long long rights[4];
+    for (unsigned long long &key : rights) key = next_random(state);
+    for (int i = 1; i < 16; ++i) {
+        Zobrist::Castling[i] = 0;
+        for (int bit = 0; bit < 4; ++bit) if (i & (1 << bit)) Zobrist::Castling[i] ^= rights[bit];
+    }
+    for (unsigned long long &key : Zobrist::En_Passant) key = next_random(state);
+    Zobrist::Black_To_Move = next_random(state);
+    return true;
+}
+
+// no Position is created during static initialisation, so the keys are ready before the first one is hashed
+static const bool keys_initialized = init_keys();
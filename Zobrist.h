@@ -0,0 +1,19 @@
+#ifndef CHESS_ZOBRIST_H
+#define CHESS_ZOBRIST_H
+
+// Random keys for hashing positions. Figures are indexed by their full code (colour | type), so the table has
+// 24 rows of which only the 12 real figures are used.
+class Zobrist {
+public:
+    static unsigned long long Pieces[24][64];
+    static unsigned long long Pawns[24][64]; // Pieces for the two pawns, 0 for every other figure: the pawn structure key
+    static unsigned long long Castling[16]; // indexed by the 4 castling right bits in Move's order (K, Q, k, q)
+    static unsigned long long En_Passant[8]; // by file of the en passant square
+    static unsigned long long Black_To_Move;
+
+    static inline unsigned long long Get_En_Passant_Key(int ep_index) {
+        return (ep_index >= 0 && ep_index < 64) ? En_Passant[ep_index & 7] : 0;
+    }
+};
+
+#endif //CHESS_ZOBRIST_H
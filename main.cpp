@@ -3,18 +3,92 @@
 #include "Position.h"
 #include <string>
 #include "Figure.h"
+#include "Bench.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Trace.h"
+#include "SplitPerft.h"
+#include "PerftSuite.h"
+#include "DistributedPerft.h"
+#include "UniquePerft.h"
+#include "Nnue.h"
+#include "EvalCache.h"
+#include "Tablebase.h"
+#include "TablebaseGenerator.h"
+#include "Syzygy.h"
+#include "PolyglotBook.h"
+#include "PackedPosition.h"
+#include "Pgn.h"
 #include <chrono>
 #include <bitset>
 #include <algorithm>
 #include <stack>
 #include <omp.h>
+#include <sstream>
+#include <fstream>
+#include <atomic>
+#include <climits>
 
 using namespace std;
 
-int main() {
+static bool starts_with(const string &input, const string &command) {
+    return input.compare(0, command.size(), command) == 0 &&
+           (input.size() == command.size() || input[command.size()] == ' ');
+}
+
+// the words after the command word
+static vector<string> arguments(const string &input) {
+    istringstream args(input);
+    vector<string> words;
+    string word;
+    args >> word;
+    while (args >> word) words.push_back(word);
+    return words;
+}
+
+// a whole number, false if the word is anything else
+static bool read_number(const string &word, long long int &value) {
+    istringstream number(word);
+    return number >> value && number.eof();
+}
+
+// the depth after the command word, left as it is if there is none; false if it is not a number >= 1
+static bool read_depth(const string &input, int &depth) {
+    vector<string> args = arguments(input);
+    if (args.empty()) return true;
+    long long int value;
+    if (!read_number(args[0], value) || value < 1 || value > 255) return false;
+    depth = (int) value;
+    return true;
+}
+
+// the count after the command word, left as it is if there is none; false unless it is the only argument and a
+// number from 1 to maximum
+static bool read_count(const string &input, int &count, int maximum) {
+    vector<string> args = arguments(input);
+    if (args.empty()) return true;
+    long long int value;
+    if (args.size() > 1 || !read_number(args[0], value) || value < 1 || value > maximum) return false;
+    count = (int) value;
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    // "Chess worker <address> [<fail after units>]" runs a distributed perft worker instead of the console
+    if (argc > 2 && string(argv[1]) == "worker") {
+        long long int fail_after = 0;
+        if (argc > 4 || (argc > 3 && (!read_number(argv[3], fail_after) || fail_after < 0 || fail_after > INT_MAX))) {
+            cerr << "usage: " << argv[0] << " worker <address> [<fail after units>]" << endl;
+            return 1;
+        }
+        return DistributedPerft::work(argv[2], (int) fail_after);
+    }
 
     Position Pos = Position();
     stack<Move> move_stack;
+    string trace_file;
 
 
     cout << "Chess Engine" << endl;
@@ -31,23 +105,596 @@ int main() {
             cout << "[i]nitial \t \t setup initial position" << endl;
             cout << "[k]iwi \t \t \t setup Kiwipete position (useful for perft tests)" << endl;
             cout << "[b]oard \t \t view current board" << endl;
+            cout << "fen \t \t \t print the FEN of the current position" << endl;
             cout << "[e]val \t \t \t view evaluation of the current position" << endl;
-            cout << "[p]erft <depth>\t \t test the move generation on current position" << endl;
-            cout << "[d]ivide <depth> \t run a perft split by move on current position" << endl;
+            cout << "[p]erft [<depth>]\t test the move generation on current position (depth 5)" << endl;
+            cout << "[d]ivide <depth> [<checkpoint file>] run a perft split by move, resumable from <checkpoint file>" << endl;
             cout << "[l]ist \t \t \t list the legal moves for current position" << endl;
-            cout << "[m]ove <move> \t \t play the move <move>" << endl;
+            cout << "san \t \t \t list the legal moves in SAN" << endl;
+            cout << "[m]ove <move> \t \t play the move <move> (e2e4 or SAN)" << endl;
             cout << "[u]ndo \t \t \t undo last played move" << endl;
             cout << "[c]alculate \t \t calculate best move for current position" << endl;
             cout << "[g]ame \t \t \t start a game against the engine on current position" << endl;
             cout << "[ccg]ame \t \t start a game engine vs engine on current position" << endl;
+            cout << "bulk [<depth>] \t perft (depth 5) that counts the last ply from the legal move generator" << endl;
+            cout << "stats [<depth>] \t perft (depth 4) counting captures, en passant, castles, promotions, checks and mates" << endl;
+            cout << "split <depth> [<split depth>] perft split into work-stealing tasks below the root" << endl;
+            cout << "dperft <depth> [<split ply> [<address> [<local workers>]]] perft served to worker processes" << endl;
+            cout << "unique <depth> [<MB> [<spill dir>]] count distinct positions per ply" << endl;
+            cout << "suite [<epd file> [<max depth> [bulk]]] check perft counts from an EPD suite (perftsuite.epd)" << endl;
+            cout << "nnue [load <file>|write <file>|on|off|bench [<games> [<ms/move>]]] network evaluation" << endl;
+            cout << "cache on|off \t \t switch the pawn structure table and evaluation cache" << endl;
+            cout << "tb [<directory>] \t map the endgame tables (*.etb) of <directory>, 'tb' alone shows the probes" << endl;
+            cout << "tbgen <directory> [<material> ...] generate endgame tables (default: all 3 figures, some 4)" << endl;
+            cout << "tbverify <directory> <material> ... check every table position against its children" << endl;
+            cout << "syzygy [<directory>|on|off] map the Syzygy tables (*.rtbw, *.rtbz) of <directory>, switch their use by the search (off), 'syzygy' alone shows the probes" << endl;
+            cout << "syzygy check <directory> <material> ... compare the Syzygy tables with the .etb tables of <directory>" << endl;
+            cout << "book [open <file>|on|off] Polyglot opening book, 'book' alone lists the book moves" << endl;
+            cout << "fenbench [<millions>] \t FEN reading and writing speed" << endl;
+            cout << "pack <fen file> <file> write the FENs of a file (one per line, up to ';') as packed positions" << endl;
+            cout << "unpack <file> [<count>] print the first <count> (10) packed positions of a file as FENs" << endl;
+            cout << "packbench [<millions>] \t packed position conversion and file speed" << endl;
+            cout << "pgn <file> \t \t read the games of a PGN file in parallel and check every move" << endl;
+            cout << "pgnbench [<games>] \t PGN writing and reading speed" << endl;
+            cout << "evalcost [<depth>] \t nps cost of the mobility and king safety terms against their budget" << endl;
+            cout << "bench [<perft depth> <search depth>] run the fixed benchmark workload" << endl;
+            cout << "scaling [<max threads> [<csv file>]] run the bench workload on 1, 2, 4, ... threads" << endl;
+            cout << "hash <MB>|off|clear \t size, switch off or clear the shared perft hash table" << endl;
+            cout << "prof \t \t \t print the hot-path profile of the last perft/divide/calculate/bench" << endl;
+            cout << "hw \t \t \t toggle hardware performance counters for perft/divide/calculate/bench" << endl;
+            cout << "alloc \t \t \t print the allocation report of the last perft/divide/calculate/bench" << endl;
+            cout << "trace [<file>] \t \t start recording a Chrome trace, 'trace' alone stops and writes it" << endl;
             cout << "[q]uit \t \t \t quit" << endl;
             cout << endl;
         }
+        else if (starts_with(input, "bulk")){
+            cout << endl;
+            int depth = 5;
+            if (!read_depth(input, depth)) {
+                cout << "usage: bulk [<depth>]" << endl;
+            } else {
+                PerfCounters::begin_region();
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                PROFILE_BEGIN("bulk perft");
+                ALLOC_BEGIN("bulk perft");
+                long long int perft_result;
+                {
+                    PerfCounters::Thread_Scope perf_scope;
+                    Trace::Span span("bulk perft", "depth", depth);
+                    perft_result = Pos.perft_bulk_parallel(depth);
+                }
+                ALLOC_END();
+                PROFILE_END();
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+                cout << "computed " << perft_result << " possible positions (depth " << depth << ", bulk counted) in " <<
+                     seconds << " seconds" << endl;
+                PerfCounters::print_report(seconds);
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "stats")){
+            cout << endl;
+            int depth = 4;
+            if (!read_depth(input, depth)) {
+                cout << "usage: stats [<depth>]" << endl;
+            } else {
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                Perft_Stats stats = Pos.perft_stats_parallel(depth);
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                cout << "depth " << depth << ": " << stats.nodes << " nodes" << endl;
+                cout << "captures: \t \t" << stats.captures << endl;
+                cout << "en passant: \t \t" << stats.en_passants << endl;
+                cout << "castles: \t \t" << stats.castles << endl;
+                cout << "promotions: \t \t" << stats.promotions << endl;
+                cout << "checks: \t \t" << stats.checks << endl;
+                cout << "discovered checks: \t" << stats.discovered_checks << endl;
+                cout << "double checks: \t \t" << stats.double_checks << endl;
+                cout << "checkmates: \t \t" << stats.checkmates << endl;
+                cout << "computed in " << ((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000) <<
+                     " seconds" << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "split")){
+            cout << endl;
+            int depth = 0;
+            int split_depth = SplitPerft::Default_Split_Depth;
+            vector<string> args = arguments(input);
+            long long int split_value = split_depth;
+            if (!read_depth(input, depth) || depth < 1 || args.size() > 2 ||
+                (args.size() > 1 && (!read_number(args[1], split_value) || split_value < 0 || split_value > 255))) {
+                cout << "usage: split <depth> [<split depth>]" << endl;
+            } else {
+                split_depth = (int) split_value;
+                vector<long long int> root_counts;
+                PerfCounters::begin_region();
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                PROFILE_BEGIN("split perft");
+                ALLOC_BEGIN("split perft");
+                long long int perft_result;
+                {
+                    PerfCounters::Thread_Scope perf_scope;
+                    Trace::Span span("split perft", "depth", depth);
+                    perft_result = SplitPerft::run(Pos, depth, split_depth, root_counts);
+                }
+                ALLOC_END();
+                PROFILE_END();
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+                cout << "computed " << perft_result << " possible positions (depth " << depth << ", split depth " <<
+                     split_depth << ") in " << seconds << " seconds" << endl;
+                PerfCounters::print_report(seconds);
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "dperft")){
+            cout << endl;
+            int depth = 0;
+            int split_ply = DistributedPerft::Default_Split_Ply;
+            string address = "5555";
+            int local_workers = omp_get_num_procs();
+            vector<string> args = arguments(input);
+            long long int split_value = split_ply;
+            long long int workers_value = local_workers;
+            if (args.size() > 2) address = args[2];
+            if (!read_depth(input, depth) || depth < 1 || args.size() > 4 ||
+                (args.size() > 1 && (!read_number(args[1], split_value) || split_value < 1 || split_value > 255)) ||
+                (args.size() > 3 && (!read_number(args[3], workers_value) || workers_value < 0 || workers_value > 1024))) {
+                cout << "usage: dperft <depth> [<split ply> [<address> [<local workers>]]]" << endl;
+            } else {
+                split_ply = (int) split_value;
+                local_workers = (int) workers_value;
+                vector<Move> root_moves = Pos.get_all_legal_moves();
+                vector<long long int> root_counts;
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                long long int perft_result;
+                {
+                    Trace::Span span("distributed perft", "depth", depth);
+                    perft_result = DistributedPerft::coordinate(Pos, depth, split_ply, address, local_workers, root_counts);
+                }
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+                if (perft_result < 0) {
+                    cout << "distributed perft failed" << endl;
+                } else {
+                    for (size_t i = 0; i < root_moves.size(); ++i) {
+                        cout << "making move: " << root_moves[i].to_letter_string() << "\t | number of positions: " <<
+                             root_counts[i] << endl;
+                    }
+                    cout << "computed " << perft_result << " possible positions (depth " << depth << ", " <<
+                         local_workers << " local workers) in " << seconds << " seconds" << endl;
+                }
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "unique")){
+            cout << endl;
+            int depth = 0;
+            size_t megabytes = UniquePerft::Default_Memory_MB;
+            vector<string> args = arguments(input);
+            string spill_dir = args.size() > 2 ? args[2] : "";
+            long long int megabytes_value = (long long int) megabytes;
+            if (!read_depth(input, depth) || depth < 1 || args.size() > 3 ||
+                (args.size() > 1 && (!read_number(args[1], megabytes_value) || megabytes_value < 1 ||
+                                     (size_t) megabytes_value > PerftTable::max_mb()))) {
+                cout << "usage: unique <depth> [<MB> [<spill dir>]], 1 to " << PerftTable::max_mb() << " MB" << endl;
+            } else {
+                megabytes = (size_t) megabytes_value;
+                vector<long long int> counts;
+                PerfCounters::begin_region();
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                bool complete;
+                {
+                    PerfCounters::Thread_Scope perf_scope;
+                    Trace::Span span("unique perft", "depth", depth);
+                    complete = UniquePerft::run(Pos, depth, megabytes, spill_dir, counts);
+                }
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000;
+                if (!complete) {
+                    cout << "key set full or spill files failed, give it more MB or a spill directory" << endl;
+                } else {
+                    for (int ply = 0; ply <= depth; ++ply) cout << "ply " << ply << ": \t" << counts[ply] << " positions" << endl;
+                    cout << "computed in " << seconds << " seconds" << endl;
+                }
+                PerfCounters::print_report(seconds);
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "suite")){
+            cout << endl;
+            string epd_file = "perftsuite.epd";
+            int max_depth = 5;
+            string mode;
+            istringstream args(input.substr(5));
+            args >> epd_file >> max_depth >> mode;
+            PerftSuite::run(epd_file, max_depth, mode == "bulk");
+            cout << endl;
+        }
+        else if (starts_with(input, "nnue")){
+            cout << endl;
+            string action;
+            string argument;
+            istringstream args(input.substr(4));
+            args >> action >> argument;
+            if (action == "load") {
+                if (Nnue::load(argument)) {
+                    Nnue::Enabled = true;
+                    Pos.refresh_accumulator();
+                    cout << "loaded " << argument << ", network evaluation on" << endl;
+                } else {
+                    cout << "could not load " << argument << " (missing file or wrong format)" << endl;
+                }
+            } else if (action == "write") {
+                if (Nnue::write_classical(argument)) cout << "classical network written to " << argument << endl;
+                else cout << "could not write " << argument << endl;
+            } else if ((action == "on" || action == "bench") && !Nnue::is_loaded()) {
+                cout << "no network loaded, use 'nnue load <file>' first" << endl;
+            } else if (action == "on") {
+                Nnue::Enabled = true;
+                Pos.refresh_accumulator();
+            } else if (action == "off") {
+                Nnue::Enabled = false;
+            } else if (action == "bench") {
+                int games = 12;
+                int milliseconds = 20;
+                string time;
+                args >> time;
+                istringstream games_number(argument);
+                istringstream time_number(time);
+                if ((!argument.empty() && !(games_number >> games)) || (!time.empty() && !(time_number >> milliseconds)) ||
+                    games < 1 || milliseconds < 1) {
+                    cout << "usage: nnue bench [<games> [<ms/move>]]" << endl;
+                } else {
+                    Bench::evaluations(Bench::Default_Search_Depth, games, milliseconds / 1000.0);
+                }
+            }
+            cout << "evaluation: " << (Nnue::Enabled ? "network " + Nnue::loaded_file() : string("classical")) <<
+                 " (" << Nnue::kernel_name() << " kernels)" << endl;
+            cout << endl;
+        }
+        else if (starts_with(input, "cache")){
+            cout << endl;
+            if (input == "cache on") EvalCache::Enabled = true;
+            else if (input == "cache off") EvalCache::Enabled = false;
+            cout << "evaluation caches " << (EvalCache::Enabled ? "on" : "off") << endl;
+            cout << endl;
+        }
+        else if (starts_with(input, "book")){
+            cout << endl;
+            string action;
+            string argument;
+            istringstream args(input.substr(4));
+            args >> action >> argument;
+            if (action == "open") {
+                if (PolyglotBook::open(argument)) cout << "opened " << argument << endl;
+                else cout << "could not open " << argument << " (missing file or not a Polyglot book)" << endl;
+            } else if (action == "on") {
+                PolyglotBook::Enabled = true;
+            } else if (action == "off") {
+                PolyglotBook::Enabled = false;
+            }
+            if (!PolyglotBook::is_ready()) {
+                cout << "no book, use 'book open <file>' first" << endl;
+            } else {
+                cout << "book " << PolyglotBook::opened_file() << " " << (PolyglotBook::Enabled ? "on" : "off") <<
+                     ", key " << hex << PolyglotBook::key(Pos) << dec << endl;
+                for (auto &entry : PolyglotBook::moves(Pos)) {
+                    cout << entry.first.to_letter_string() << " \t weight " << entry.second << endl;
+                }
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "tbgen")){
+            cout << endl;
+            string directory;
+            vector<string> materials;
+            istringstream args(input.substr(5));
+            args >> directory;
+            for (string material; args >> material;) materials.push_back(material);
+            if (materials.empty()) materials = TablebaseGenerator::Default_Materials;
+            if (directory.empty()) {
+                cout << "usage: tbgen <directory> [<material> ...]" << endl;
+            } else {
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                int count = TablebaseGenerator::generate_all(materials, directory);
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                cout << "generated " << count << " tables in " <<
+                     (double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000 <<
+                     " seconds (" << omp_get_max_threads() << " threads)" << endl;
+                cout << Tablebase::statistics() << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "tbverify")){
+            cout << endl;
+            string directory;
+            vector<string> materials;
+            istringstream args(input.substr(8));
+            args >> directory;
+            for (string material; args >> material;) materials.push_back(material);
+            if (materials.empty()) {
+                cout << "usage: tbverify <directory> <material> ..." << endl;
+            } else {
+                int failed = 0;
+                for (const string &material : materials) failed += TablebaseGenerator::verify(material, directory) ? 0 : 1;
+                cout << materials.size() - failed << " of " << materials.size() << " tables consistent" << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "tb")){
+            cout << endl;
+            if (input.size() > 3) {
+                string directory = input.substr(3);
+                int count = Tablebase::load(directory);
+                cout << "mapped " << count << " endgame tables from " << directory << endl;
+            }
+            cout << Tablebase::statistics() << endl;
+            int wdl;
+            int dtm;
+            if (Tablebase::probe(Pos, wdl, dtm)) {
+                static const string Results[3] = { "draw", "won", "lost" };
+                cout << "current position: " << Results[wdl] << " for the side to move";
+                if (wdl != Tablebase::Draw) cout << ", mate in " << dtm << " plies";
+                cout << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "syzygy check")){
+            cout << endl;
+            vector<string> args = arguments(input);
+            if (args.size() < 3) {
+                cout << "usage: syzygy check <directory of .etb tables> <material> ..." << endl;
+            } else if (Syzygy::largest() == 0) {
+                cout << "no syzygy tables loaded, use 'syzygy <directory>' first" << endl;
+            } else {
+                int failed = 0;
+                for (size_t i = 2; i < args.size(); ++i) {
+                    failed += TablebaseGenerator::compare_syzygy(args[i], args[1]) ? 0 : 1;
+                }
+                cout << args.size() - 2 - failed << " of " << args.size() - 2 << " tables agree" << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "syzygy")){
+            cout << endl;
+            if (input == "syzygy on") {
+                Syzygy::Enabled = true;
+            } else if (input == "syzygy off") {
+                Syzygy::Enabled = false;
+            } else if (input.size() > 7) {
+                string directory = input.substr(7);
+                int count = Syzygy::load(directory);
+                cout << "mapped " << count << " syzygy files from " << directory << endl;
+            }
+            cout << Syzygy::statistics() << endl;
+            int wdl;
+            if (Syzygy::probe_wdl(Pos, wdl)) {
+                static const string Results[5] = { "lost", "lost, but drawn by the fifty-move rule", "draw",
+                                                   "won, but drawn by the fifty-move rule", "won" };
+                cout << "current position: " << Results[wdl + 2] << " for the side to move";
+                int dtz;
+                if (Syzygy::probe_dtz(Pos, dtz)) cout << ", " << dtz << " plies to zeroing";
+                cout << endl;
+            }
+            vector<Move> moves;
+            if (Syzygy::root_moves(Pos, moves)) {
+                cout << "best table moves:";
+                for (Move move : moves) cout << " " << Pos.to_san(move) << " (dtz " << move.value << ")";
+                cout << endl;
+            }
+            cout << endl;
+        }
+        else if (input == "fen"){
+            cout << endl;
+            cout << Pos.to_fen() << endl;
+            cout << endl;
+        }
+        else if (input == "san"){
+            cout << endl;
+            cout << "legal moves: ";
+            for (Move move : Pos.get_all_legal_moves()) cout << Pos.to_san(move) << " ";
+            cout << endl;
+            cout << endl;
+        }
+        else if (starts_with(input, "fenbench")){
+            cout << endl;
+            int millions = 2;
+            if (!read_count(input, millions, 1000)) cout << "usage: fenbench [<millions>], 1 to 1000" << endl;
+            else Bench::fen(millions);
+            cout << endl;
+        }
+        else if (starts_with(input, "packbench")){
+            cout << endl;
+            int millions = 2;
+            if (!read_count(input, millions, 1000)) cout << "usage: packbench [<millions>], 1 to 1000" << endl;
+            else Bench::packed(millions, "packbench.bin");
+            cout << endl;
+        }
+        else if (starts_with(input, "pack")){
+            cout << endl;
+            string fen_file;
+            string packed_file;
+            istringstream args(input.substr(4));
+            args >> fen_file >> packed_file;
+            ifstream fens(fen_file);
+            PackedPosition::Writer writer;
+            if (packed_file.empty() || !fens || !writer.open(packed_file)) {
+                cout << "usage: pack <fen file> <file>" << endl;
+            } else {
+                long long int written = 0;
+                long long int invalid = 0;
+                Position pos;
+                for (string line; getline(fens, line);) {
+                    size_t length = min(line.find(';'), line.size());
+                    size_t first = line.find_first_not_of(" \t\r");
+                    if (first >= length || line[first] == '#') continue;
+                    if (!pos.set_fen(line.data(), length)) invalid++;
+                    else if (writer.write(pos)) written++;
+                }
+                if (writer.close()) cout << "packed " << written << " positions";
+                else cout << "could not write " << packed_file;
+                cout << ", " << invalid << " lines were no valid FEN" << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "unpack")){
+            cout << endl;
+            string packed_file;
+            long long int count = 10;
+            istringstream args(input.substr(6));
+            args >> packed_file >> count;
+            PackedPosition::Reader reader;
+            if (!reader.open(packed_file)) {
+                cout << "usage: unpack <file> [<count>]" << endl;
+            } else {
+                Packed_Position record;
+                Position pos;
+                for (long long int i = 0; i < count && reader.next(record); ++i) {
+                    cout << (PackedPosition::unpack(record, pos) ? pos.to_fen() : "(no position)") << endl;
+                }
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "pgnbench")){
+            cout << endl;
+            int games = 20000;
+            if (!read_count(input, games, 10000000)) cout << "usage: pgnbench [<games>], 1 to 10000000" << endl;
+            else Bench::pgn(games, "pgnbench.pgn");
+            cout << endl;
+        }
+        else if (starts_with(input, "pgn")){
+            cout << endl;
+            string filename = input.size() > 4 ? input.substr(4) : "";
+            atomic<size_t> first_invalid(SIZE_MAX);
+            Pgn_Statistics statistics;
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            bool read = Pgn::read_file(filename, [&](const Pgn_Game &game, int) {
+                size_t offset = first_invalid.load();
+                while (!game.valid && game.offset < offset && !first_invalid.compare_exchange_weak(offset, game.offset));
+            }, statistics);
+            double seconds = (double) std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - begin).count() / 1000;
+            if (!read) {
+                cout << "usage: pgn <file>" << endl;
+            } else {
+                cout << statistics.games << " games, " << statistics.plies << " moves in " << seconds << " seconds (" <<
+                     statistics.bytes / 1e6 / max(seconds, 0.001) << " MB/s, " << omp_get_max_threads() << " threads)" << endl;
+                if (statistics.invalid > 0) {
+                    cout << statistics.invalid << " games with a move that could not be read, the first at byte " <<
+                         first_invalid.load() << endl;
+                }
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "evalcost")){
+            cout << endl;
+            int depth = Bench::Default_Search_Depth + 1;
+            istringstream args(input.substr(8));
+            args >> depth;
+            Bench::activity_cost(depth);
+            cout << endl;
+        }
+        else if (starts_with(input, "bench")){
+            cout << endl;
+            int perft_depth = Bench::Default_Perft_Depth;
+            int search_depth = Bench::Default_Search_Depth;
+            vector<string> args = arguments(input);
+            long long int perft_value = perft_depth;
+            long long int search_value = search_depth;
+            if ((!args.empty() && (args.size() != 2 || !read_number(args[0], perft_value) ||
+                                   !read_number(args[1], search_value))) ||
+                perft_value < 1 || perft_value > 255 || search_value < 1 || search_value > 255) {
+                cout << "usage: bench [<perft depth> <search depth>]" << endl;
+            } else {
+                perft_depth = (int) perft_value;
+                search_depth = (int) search_value;
+                PerfCounters::begin_region();
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                {
+                    PerfCounters::Thread_Scope perf_scope;
+                    Trace::Span span("bench");
+                    Bench::run(perft_depth, search_depth);
+                }
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                PerfCounters::print_report((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000);
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "scaling")){
+            cout << endl;
+            int max_threads = omp_get_num_procs();
+            string csv_file = "scaling.csv";
+            istringstream args(input.substr(7));
+            args >> max_threads >> csv_file;
+            if (max_threads < 1) max_threads = 1;
+            if (Bench::scaling(max_threads, Bench::Default_Perft_Depth, Bench::Default_Search_Depth, csv_file)) {
+                cout << "results written to " << csv_file << endl;
+            } else {
+                cout << "could not write " << csv_file << endl;
+            }
+            cout << endl;
+        }
+        else if (starts_with(input, "hash")){
+            cout << endl;
+            if (input == "hash clear") {
+                Position::Perft_Table.clear();
+                cout << "perft hash table cleared" << endl;
+            } else if (input == "hash off") {
+                Position::Perft_Table.resize(0);
+                cout << "perft hash table off" << endl;
+            } else if (input.size() > 5) {
+                vector<string> args = arguments(input);
+                long long int megabytes;
+                if (args.size() != 1 || !read_number(args[0], megabytes) || megabytes < 1 ||
+                    (size_t) megabytes > PerftTable::max_mb()) {
+                    cout << "usage: hash <MB>|off|clear, 1 to " << PerftTable::max_mb() << " MB" << endl;
+                } else if (!Position::Perft_Table.resize((size_t) megabytes)) {
+                    cout << "could not allocate " << megabytes << " MB, the table is unchanged" << endl;
+                }
+                cout << "perft hash table: " << Position::Perft_Table.size_mb() << " MB" << endl;
+            } else {
+                cout << "perft hash table: " << Position::Perft_Table.size_mb() << " MB, " <<
+                     Position::Perft_Table.hashfull() << " per mille used" << endl;
+            }
+            cout << endl;
+        }
+        else if (input == "prof"){
+            cout << endl;
+            Profiler::print_report();
+            cout << endl;
+        }
+        else if (input == "alloc"){
+            cout << endl;
+            AllocTracker::print_report();
+            cout << endl;
+        }
+        else if (starts_with(input, "trace")){
+            cout << endl;
+            if (input.size() > 6) {
+                trace_file = input.substr(6);
+                Trace::start();
+                cout << "recording trace to " << trace_file << endl;
+            } else if (Trace::enabled) {
+                if (Trace::stop(trace_file)) cout << "trace written to " << trace_file << endl;
+                else cout << "could not write " << trace_file << endl;
+            } else {
+                cout << "no trace is recording, type 'trace <file>'" << endl;
+            }
+            cout << endl;
+        }
+        else if (input == "hw"){
+            cout << endl;
+            PerfCounters::enabled = !PerfCounters::enabled;
+            cout << "hardware performance counters " << (PerfCounters::enabled ? "on" : "off") << endl;
+            cout << endl;
+        }
         else if (input[0] == 's'){
             cout << endl;
             cout << "setting board..." << endl;
             string fen = input.substr(2);
-            Pos = Position(fen);
+            if (!Pos.set_fen(fen.data(), fen.size())) cout << "not a valid FEN, the position is unchanged" << endl;
             Pos.print_board();
             cout << endl;
         }
@@ -77,25 +724,57 @@ int main() {
         }
         else if (input[0] == 'p'){
             cout << endl;
-            int depth = input[2] - '0';
-            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-            long long int perft_result = Pos.perft_parallel(depth);
-            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-            cout << "computed " << perft_result << " possible positions (depth " << depth <<
-            ") in " << ((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000) <<
-            " seconds" << endl;
+            int depth = 5;
+            if (!read_depth(input, depth)) {
+                cout << "usage: perft [<depth>]" << endl;
+            } else {
+                PerfCounters::begin_region();
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                PROFILE_BEGIN("perft");
+                ALLOC_BEGIN("perft");
+                long long int perft_result;
+                {
+                    PerfCounters::Thread_Scope perf_scope;
+                    Trace::Span span("perft", "depth", depth);
+                    perft_result = Pos.perft_parallel(depth);
+                }
+                ALLOC_END();
+                PROFILE_END();
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                cout << "computed " << perft_result << " possible positions (depth " << depth <<
+                ") in " << ((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000) <<
+                " seconds" << endl;
+                PerfCounters::print_report((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000);
+            }
             cout << endl;
         }
         else if (input[0] == 'd'){
             cout << endl;
-            int depth = input[2] - '0';
-            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-            long long int perft_result = Pos.perft_divide_parallel(depth);
-            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-            cout << endl << endl;
-            cout << "computed " << perft_result << " possible positions (depth " << depth <<
-                 ") in " << ((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000) <<
-                 " seconds" << endl;
+            int depth = 0;
+            vector<string> args = arguments(input);
+            string checkpoint_file = args.size() > 1 ? args[1] : "";
+            if (!read_depth(input, depth) || depth < 1 || args.size() > 2) {
+                cout << "usage: divide <depth> [<checkpoint file>]" << endl;
+            } else {
+                PerfCounters::begin_region();
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                PROFILE_BEGIN("divide");
+                ALLOC_BEGIN("divide");
+                long long int perft_result;
+                {
+                    PerfCounters::Thread_Scope perf_scope;
+                    Trace::Span span("divide", "depth", depth);
+                    perft_result = Pos.perft_divide_parallel(depth, checkpoint_file);
+                }
+                ALLOC_END();
+                PROFILE_END();
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                cout << endl << endl;
+                cout << "computed " << perft_result << " possible positions (depth " << depth <<
+                     ") in " << ((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000) <<
+                     " seconds" << endl;
+                PerfCounters::print_report((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000);
+            }
             cout << endl;
         }
         else if (input == "l"){
@@ -111,15 +790,19 @@ int main() {
         else if (input[0] == 'm'){
             cout << endl;
             string move_string = input.substr(2);
-            Move move = Move(move_string);
+            // coordinates (e2e4, e7e8n) or SAN (e4, Nxf7+, O-O)
+            Move move = move_string.size() >= 4 ? Move(move_string) : Move();
             vector<Move> legal_moves = Pos.get_all_legal_moves();
+            if (std::find(legal_moves.begin(), legal_moves.end(), move) == legal_moves.end()) {
+                Pos.parse_san(move_string.data(), move_string.size(), move);
+            }
             if(std::find(legal_moves.begin(), legal_moves.end(), move) != legal_moves.end()) {
                 cout << "making move: " << move.to_letter_string() << endl;
                 Pos.make_move(move);
                 move_stack.push(move);
                 Pos.print_board();
             } else {
-                cout << "move " << move.to_letter_string() << " is not possible" << endl;
+                cout << "move " << move_string << " is not possible" << endl;
             }
             cout << endl;
         }
@@ -140,7 +823,26 @@ int main() {
         else if (input == "c"){
             cout << endl;
             cout << "calculating best move..." << endl;
-            Move move = Pos.get_best_move();
+            PerfCounters::begin_region();
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            PROFILE_BEGIN("calculate");
+            ALLOC_BEGIN("calculate");
+            EvalCache::reset_statistics();
+            Tablebase::reset_statistics();
+            Syzygy::reset_statistics();
+            Move move;
+            {
+                PerfCounters::Thread_Scope perf_scope;
+                Trace::Span span("calculate");
+                move = Pos.get_best_move();
+            }
+            ALLOC_END();
+            PROFILE_END();
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            cout << EvalCache::statistics() << endl;
+            if (Tablebase::largest() > 0) cout << Tablebase::statistics() << endl;
+            if (Syzygy::largest() > 0) cout << Syzygy::statistics() << endl;
+            PerfCounters::print_report((double) std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000);
             cout << endl;
             cout << endl;
         }